@@ -8,15 +8,18 @@
 #include <ros/ros.h>
 #include <sensor_msgs/LaserScan.h>
 #include <std_msgs/Bool.h>
+#include <mcr_scan_geometry/scan_geometry.h>
 
 sensor_msgs::LaserScanConstPtr g_pLaserScanFront;
+ScanGeometry g_scanGeometry;
+size_t g_unFirstBeamInRange = 0;
+size_t g_unEndBeamInRange = 0;
 bool bIsDoorOpen = false;
 double dOpeningAngle = 10.0;
 double dDistanceThreshold = 1.0;
 
 bool publish_door_state()
 {
-    double dAngle = 0.0;
     double dSummedDistance = 0.0;
     unsigned int dCountInAngleRange = 0;
 
@@ -24,16 +27,15 @@ bool publish_door_state()
         return false;
 
 
+    // the beams inside the desired opening angle only change if the scan geometry changes
+    if (g_scanGeometry.update(*g_pLaserScanFront))
+        g_scanGeometry.getIndexRange(-dOpeningAngle, dOpeningAngle, g_unFirstBeamInRange, g_unEndBeamInRange);
+
     //sum up distance in the desired opening angle
-    dAngle = g_pLaserScanFront->angle_min;
-    for (unsigned int i = 0; i < g_pLaserScanFront->ranges.size(); ++i, dAngle += g_pLaserScanFront->angle_increment)
+    for (size_t i = g_unFirstBeamInRange; i < g_unEndBeamInRange; ++i)
     {
-        //check angle against desired range and only take those distance measures
-        if ((dAngle >= -dOpeningAngle) && (dAngle <= dOpeningAngle))
-        {
-            dSummedDistance += g_pLaserScanFront->ranges[i];
-            ++dCountInAngleRange;
-        }
+        dSummedDistance += g_pLaserScanFront->ranges[i];
+        ++dCountInAngleRange;
     }
 
     //calc mean
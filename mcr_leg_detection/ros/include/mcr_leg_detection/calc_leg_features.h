@@ -35,11 +35,23 @@
 #ifndef CALCLEGFEATURES_HH
 #define CALCLEGFEATURES_HH
 
+#include <stdint.h>
+
 #include "laser_processor.h"
-#include <sensor_msgs/LaserScan.h>
+#include <mcr_scan_geometry/scan_geometry.h>
+
+//! Number of features calcLegFeatures computes for every cluster
+const int LEG_FEATURE_COUNT = 14;
+
+//! Feature mask with all LEG_FEATURE_COUNT features, bit i stands for feature i
+const uint32_t ALL_LEG_FEATURES = (1u << LEG_FEATURE_COUNT) - 1;
 
-// TODO: Should remove scan dependency from here.
-// Only used for jump distance
-std::vector<float> calcLegFeatures(laser_processor::SampleSet* cluster, const sensor_msgs::LaserScan& scan);
+/** Computes the features of the cluster in feature_mask and writes all LEG_FEATURE_COUNT of them
+  * to features, e.g. a row of the feature matrix of all clusters of a scan. The features that are
+  * not in the mask are skipped and written as zero. Apart from the median buffer of unusually
+  * large clusters nothing is allocated.
+  * The Cartesian scan is only used for the jump distance. */
+void calcLegFeatures(const laser_processor::SampleSet& cluster, const CartesianScan& scan, float* features,
+                     uint32_t feature_mask = ALL_LEG_FEATURES);
 
 #endif
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2018 Bonn-Rhein-Sieg University
+ */
+#ifndef MCR_LEG_DETECTION_FLAT_FOREST_H
+#define MCR_LEG_DETECTION_FLAT_FOREST_H
+
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/ml/ml.hpp>
+
+/**
+ * A trained cv::ml::RTrees classifier, flattened into one contiguous array of nodes.
+ *
+ * The prediction walks the trees exactly like RTrees::predict does for ordered variables and
+ * takes the majority vote of the trees (ties go to the lower class index), so the results are
+ * identical. load() verifies this on probe samples. A batch of samples is classified tree by tree, which keeps the nodes of the current
+ * tree in the cache.
+ *
+ * The tables can also be written as C++ code (see leg_forest_codegen) and compiled into the
+ * leg detector for a fixed model.
+ */
+class FlatForest
+{
+public:
+    /**
+     * A node of one of the trees. An inner node sends a sample to child[0] if sample[var] <= threshold
+     * and to child[1] otherwise (which includes NaN), a missing value (FLT_MAX) goes to default_child.
+     * A leaf has var == -1 and stores its class index in child[0]. All indices are absolute node indices.
+     */
+    struct Node
+    {
+        int32_t var;
+        float threshold;
+        int32_t child[2];
+        int32_t default_child;
+    };
+
+    FlatForest();
+
+    /** A copy of a loaded forest has its own tables, a copy of assigned tables uses the same ones */
+    FlatForest(const FlatForest& other);
+    FlatForest& operator=(const FlatForest& other);
+
+    /** Flattens the trees of a trained classifier. Returns false for models with categorical
+      * variables or regression models, which are not supported, and for models whose prediction the
+      * tables do not reproduce on a set of probe samples, e.g. models trained on a subset of the
+      * variables or with substituted missing values. */
+    bool load(const cv::ml::RTrees& forest);
+
+    /** Uses the given tables without copying them, e.g. the ones generated by writeCode() */
+    void assign(const Node* nodes, size_t num_nodes, const int32_t* roots, size_t num_trees,
+                const float* class_labels, size_t num_classes);
+
+    bool empty() const
+    {
+        return num_trees_ == 0;
+    }
+
+    /** The number of features a sample needs, i.e. the largest variable index used in a split plus one */
+    int getVarCount() const
+    {
+        return var_count_;
+    }
+
+    /** Fills num_splits with the number of splits on each of the getVarCount() variables. Variables
+      * without splits never influence the prediction. */
+    void getVarUsage(std::vector<int>& num_splits) const;
+
+    /** Classifies a single sample with at least getVarCount() features */
+    float predict(const float* sample) const;
+
+    /** Classifies every row of samples (CV_32FC1), responses becomes a samples.rows x 1 CV_32FC1 matrix */
+    void predict(const cv::Mat& samples, cv::Mat& responses) const;
+
+    /** Writes the tables as a C++ header with constexpr arrays nodes, roots and class_labels in the
+      * namespace name_space */
+    void writeCode(std::ostream& out, const std::string& name_space, const std::string& comment) const;
+
+private:
+    std::vector<Node> node_storage_;
+    std::vector<int32_t> root_storage_;
+    std::vector<float> class_label_storage_;
+
+    const Node* nodes_;
+    size_t num_nodes_;
+    const int32_t* roots_;
+    size_t num_trees_;
+    const float* class_labels_;
+    size_t num_classes_;
+    int var_count_;
+
+    void clear();
+
+    //! compares the prediction of the tables with the one of forest on probe samples
+    bool reproducesPrediction(const cv::ml::RTrees& forest) const;
+
+    inline int32_t findLeaf(int32_t node, const float* sample) const;
+    inline float vote(const int* votes) const;
+};
+
+#endif  // MCR_LEG_DETECTION_FLAT_FOREST_H
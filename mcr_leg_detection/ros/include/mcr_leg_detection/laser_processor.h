@@ -57,6 +57,8 @@
 
 #include <tf/transform_datatypes.h>
 
+#include <mcr_scan_geometry/scan_geometry.h>
+
 namespace laser_processor
 {
 //! A struct representing a single sample from the laser.
@@ -69,84 +71,171 @@ public:
     float x;
     float y;
 
-    static Sample* Extract(int ind, const sensor_msgs::LaserScan& scan);
+    Sample() : index(0), range(0), intensity(0), x(0), y(0) {}
 
-private:
-    Sample() {};
+    //! Fills the sample with beam ind of the scan, returns false if the beam is out of range
+    static bool Extract(int ind, const CartesianScan& scan, Sample& sample);
 };
 
-//! The comparator allowing the creation of an ordered "SampleSet"
-struct CompareSample
+
+//! An ordered set of Samples, stored as a contiguous range of the samples of a ScanProcessor
+class SampleSet
 {
-    CompareSample() {}
+    const Sample* begin_;
+    const Sample* end_;
+
+public:
+    typedef const Sample* iterator;
+    typedef const Sample* const_iterator;
+
+    SampleSet() : begin_(NULL), end_(NULL) {}
 
-    inline bool operator()(const Sample* a, const Sample* b)
+    SampleSet(const Sample* begin, const Sample* end) : begin_(begin), end_(end) {}
+
+    iterator begin() const
     {
-        return (a->index <  b->index);
+        return begin_;
     }
-};
 
+    iterator end() const
+    {
+        return end_;
+    }
 
-//! An ordered set of Samples
-class SampleSet : public std::set<Sample*, CompareSample>
-{
-public:
-    SampleSet() {}
+    size_t size() const
+    {
+        return end_ - begin_;
+    }
 
-    ~SampleSet()
+    bool empty() const
     {
-        clear();
+        return begin_ == end_;
     }
 
-    void clear();
+    const Sample& front() const
+    {
+        return *begin_;
+    }
 
-    void appendToCloud(sensor_msgs::PointCloud& cloud, int r = 0, int g = 0, int b = 0);
+    const Sample& back() const
+    {
+        return *(end_ - 1);
+    }
 
-    tf::Point center();
+    void appendToCloud(sensor_msgs::PointCloud& cloud, int r = 0, int g = 0, int b = 0) const;
+
+    tf::Point center() const;
 };
 
-//! A mask for filtering out Samples based on range
+//! The beams [first, second) of a scan
+typedef std::pair<uint32_t, uint32_t> BeamWindow;
+
+//! Sorts the windows and joins the overlapping and adjacent ones
+void mergeBeamWindows(std::vector<BeamWindow>& windows);
+
+/** A mask for filtering out Samples based on range. It holds the range of the static background
+  * for every beam, learned from scans taken while the scanner stands still. A sample which is
+  * not clearly in front of the background is part of the background. */
 class ScanMask
 {
-    SampleSet mask_;
+    //! background range per beam, infinity where nothing is known about the background
+    std::vector<float> background_;
+
+    float    decay_;
+    uint32_t min_scans_;
+    uint32_t num_scans_;
 
-    bool     filled;
-    float    angle_min;
-    float    angle_max;
-    uint32_t size;
+    float    angle_min_;
+    float    angle_increment_;
 
 public:
 
-    ScanMask() : filled(false), angle_min(0), angle_max(0), size(0) { }
+    ScanMask() : decay_(1.0), min_scans_(1), num_scans_(0), angle_min_(0), angle_increment_(0) { }
 
     inline void clear()
     {
-        mask_.clear();
-        filled = false;
+        background_.clear();
+        num_scans_ = 0;
     }
 
-    void addScan(sensor_msgs::LaserScan& scan);
+    /** decay is the weight of a new scan in the background, the mask is only applied once
+      * min_scans scans have been added */
+    void setLearningParameters(float decay, uint32_t min_scans);
 
-    bool hasSample(Sample* s, float thresh);
-};
+    /** Blends the scan into the background, a scan with a different geometry restarts the learning.
+      * The beams inside the excluded windows, which have to be merged with mergeBeamWindows, keep
+      * their background, so people standing in front of the scanner are not learned. */
+    void addScan(const sensor_msgs::LaserScan& scan, const CartesianScan& cartesian,
+                 const std::vector<BeamWindow>& excluded = std::vector<BeamWindow>());
+
+    uint32_t getNumScans() const
+    {
+        return num_scans_;
+    }
 
+    inline bool isActive() const
+    {
+        return num_scans_ >= min_scans_;
+    }
 
+    //! Returns true if the beam at index with the given range belongs to the background
+    inline bool hasBeam(uint32_t index, float range, float thresh) const
+    {
+        return index < background_.size() && (background_[index] - thresh) < range;
+    }
 
+    inline bool hasSample(const Sample& s, float thresh) const
+    {
+        return hasBeam(s.index, s.range, thresh);
+    }
+};
+
+
+/** Clusters the samples of a scan. All samples live in a single buffer which is reused
+  * from scan to scan, and every cluster is a contiguous range of that buffer. */
 class ScanProcessor
 {
-    std::list<SampleSet*> clusters_;
-    sensor_msgs::LaserScan scan_;
+    //! valid and unmasked samples of the current scan, ordered by index
+    std::vector<Sample> samples_;
+    //! the same samples, grouped by cluster
+    std::vector<Sample> clustered_samples_;
+    std::vector<SampleSet> clusters_;
+    float angle_increment_;
+
+    // scratch buffers of splitConnected
+    std::vector<int> next_remaining_;
+    std::vector<int> prev_remaining_;
+    std::vector<int> labels_;
+    std::vector<size_t> cluster_offsets_;
+    std::vector<size_t> cluster_ends_;
+
+    inline void unlinkRemaining(int i)
+    {
+        next_remaining_[prev_remaining_[i]] = next_remaining_[i];
+        prev_remaining_[next_remaining_[i]] = prev_remaining_[i];
+    }
+
+    void addBeams(uint32_t begin, uint32_t end, const CartesianScan& cartesian, const ScanMask& mask_,
+                  float mask_threshold);
 
 public:
 
-    std::list<SampleSet*>& getClusters()
+    std::vector<SampleSet>& getClusters()
     {
         return clusters_;
     }
 
-    ScanProcessor(const sensor_msgs::LaserScan& scan, ScanMask& mask_, float mask_threshold = 0.03);
+    ScanProcessor() : angle_increment_(0) {}
+
+    //! Replaces the samples with the ones of the given scan, all of them in a single cluster
+    //! Beams of the mask's background are dropped, if the mask is active
+    void setScan(const sensor_msgs::LaserScan& scan, const CartesianScan& cartesian, const ScanMask& mask_,
+                 float mask_threshold = 0.03);
 
-    ~ScanProcessor();
+    //! Like setScan, but only takes the beams inside the windows, which have to be merged
+    //! with mergeBeamWindows
+    void setScan(const sensor_msgs::LaserScan& scan, const CartesianScan& cartesian, const ScanMask& mask_,
+                 const std::vector<BeamWindow>& windows, float mask_threshold = 0.03);
 
     void removeLessThan(uint32_t num);
 
@@ -0,0 +1,298 @@
+/*
+ * Copyright 2018 Bonn-Rhein-Sieg University
+ */
+#ifndef MCR_LEG_DETECTION_LEG_DETECTOR_H
+#define MCR_LEG_DETECTION_LEG_DETECTOR_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <Eigen/StdVector>
+#include <opencv2/core/core.hpp>
+#include <ros/time.h>
+#include <sensor_msgs/LaserScan.h>
+#include <tf/transform_datatypes.h>
+
+#include <mcr_scan_geometry/scan_geometry.h>
+
+#include "mcr_leg_detection/laser_processor.h"
+#include "mcr_leg_detection/calc_leg_features.h"
+#include "mcr_leg_detection/flat_forest.h"
+#include "mcr_leg_detection/tracker_kalman.h"
+#include "mcr_leg_detection/track_association.h"
+#include "mcr_leg_detection/state_pos_vel.h"
+
+/** A tracked leg, a Kalman filter on its position in the fixed frame */
+class LegTrack
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    BFL::StatePosVel sys_sigma_;
+    estimation::TrackerKalman filter_;
+
+    std::string id_;
+    std::string object_id;
+    ros::Time time_;
+    ros::Time meas_time_;
+
+    //! the last measurement, in the fixed frame
+    tf::Stamped<tf::Point> meas_position_;
+    //! the estimated position, in the fixed frame
+    tf::Stamped<tf::Point> position_;
+    float dist_to_person_;
+
+    //! starts a track at the location, which has to be in the fixed frame
+    explicit LegTrack(const tf::Stamped<tf::Point>& loc);
+
+    void propagate(ros::Time time);
+
+    void update(const tf::Stamped<tf::Point>& loc);
+
+    double getLifetime() const
+    {
+        return filter_.getLifetime();
+    }
+
+private:
+    static int nextid;
+
+    void updatePosition();
+};
+
+/** Durations of the stages of the last scan in seconds */
+struct LegDetectorTimings
+{
+    //! scan conversion, background removal and clustering
+    double segmentation;
+    double features;
+    double classification;
+    //! prediction, association and update of the tracks
+    double tracking;
+
+    LegDetectorTimings() : segmentation(0), features(0), classification(0), tracking(0) {}
+};
+
+struct LegDetectorParameters
+{
+    bool background_learning_enabled;
+    float background_decay;
+    uint32_t background_min_scans;
+
+    bool roi_enabled;
+    int roi_full_scan_period;
+    double roi_margin;
+
+    LegDetectorParameters()
+        : background_learning_enabled(false), background_decay(0.02), background_min_scans(50),
+          roi_enabled(false), roi_full_scan_period(5), roi_margin(0.5)
+    {
+    }
+};
+
+/**
+ * Finds the leg candidates in the scans of one scanner: clustering of a scan, leg features and
+ * classification with a random forest. Every scanner needs its own detector, detectors of
+ * different scanners can run in parallel.
+ */
+class LegCandidateDetector
+{
+public:
+    //! candidates are transformed into fixed_frame
+    explicit LegCandidateDetector(const std::string& fixed_frame);
+
+    /** Uses the forest to classify the clusters and only computes the features it splits on.
+      * Returns false if the forest is empty or needs more than the leg features. */
+    bool setForest(const FlatForest& forest);
+
+    uint32_t getFeatureMask() const
+    {
+        return feature_mask_;
+    }
+
+    void setParameters(const LegDetectorParameters& params)
+    {
+        params_ = params;
+    }
+
+    /**
+     * Finds the leg candidates in the scan.
+     * scan_to_fixed is the pose of the scanner in the fixed frame at the time of the scan, NULL if it
+     * is unknown, in which case the candidates stay in the scanner frame and the scan is processed
+     * completely. scanner_stationary tells whether the scanner stood still since the last scan,
+     * which is when the background is learned. The positions of the tracks in the fixed frame select
+     * the beams of the ROI mode.
+     */
+    void detect(const sensor_msgs::LaserScan& scan, const tf::Transform* scan_to_fixed, bool scanner_stationary,
+                const std::vector<tf::Point>& track_positions);
+
+    //! the candidates of the last scan
+    const std::vector<tf::Stamped<tf::Point> >& getCandidates() const
+    {
+        return candidates_;
+    }
+
+    //! number of clusters of the last scan
+    size_t getNumClusters() const
+    {
+        return num_clusters_;
+    }
+
+    //! whether all beams of the last scan were processed, see LegDetectorParameters::roi_enabled
+    bool wasFullScan() const
+    {
+        return full_scan_;
+    }
+
+    //! durations of the detection stages of the last scan, tracking is not set
+    const LegDetectorTimings& getTimings() const
+    {
+        return timings_;
+    }
+
+private:
+    std::string fixed_frame_;
+    LegDetectorParameters params_;
+
+    ScanGeometry scan_geometry_;
+    CartesianScan cartesian_scan_;
+    laser_processor::ScanProcessor processor_;
+    laser_processor::ScanMask mask_;
+    float connected_thresh_;
+
+    FlatForest forest_;
+    //! the leg features the forest splits on, the others are not computed
+    uint32_t feature_mask_;
+    //! features of the clusters of a scan, one row per cluster (grown on demand, never shrunk)
+    cv::Mat features_;
+    cv::Mat responses_;
+
+    std::vector<tf::Stamped<tf::Point> > candidates_;
+
+    //! scans processed only around the tracks since the last full scan
+    int scans_since_full_scan_;
+    std::vector<laser_processor::BeamWindow> roi_windows_;
+    bool full_scan_;
+
+    size_t num_clusters_;
+    LegDetectorTimings timings_;
+
+    //! beams of the last scan which are not learned into the background
+    std::vector<laser_processor::BeamWindow> background_excluded_;
+
+    void updateBackground(const sensor_msgs::LaserScan& scan, const tf::Transform* scan_to_fixed,
+                          bool scanner_stationary, const std::vector<tf::Point>& track_positions);
+
+    /** Collects the beams which pass within roi_margin of the tracks in windows.
+      * Returns false if the whole scan has to be processed, i.e. a track is within the margin
+      * around the scanner. */
+    bool computeTrackWindows(const sensor_msgs::LaserScan& scan, const tf::Transform& scan_to_fixed,
+                             const std::vector<tf::Point>& track_positions,
+                             std::vector<laser_processor::BeamWindow>& windows);
+};
+
+/**
+ * The leg tracks in the fixed frame. The candidates of all scanners go through the same tracks
+ * in the order of their time stamps.
+ */
+class LegTracker
+{
+public:
+    typedef std::vector<LegTrack, Eigen::aligned_allocator<LegTrack> > TrackList;
+
+    LegTracker();
+
+    /** Drops the tracks without a measurement for a while and predicts the others to the time stamp */
+    void predict(const ros::Time& stamp);
+
+    /** Assigns the candidates to the predicted tracks and updates them. The other candidates start
+      * new tracks, if allowed. */
+    void update(const std::vector<tf::Stamped<tf::Point> >& candidates, bool allow_new_tracks);
+
+    const TrackList& getTracks() const
+    {
+        return tracks_;
+    }
+
+    //! the estimated positions of the tracks
+    void getPositions(std::vector<tf::Point>& positions) const;
+
+private:
+    //! the leg trackers, stored by value
+    TrackList tracks_;
+    estimation::TrackAssociation association_;
+    std::vector<tf::Point> track_positions_;
+    std::vector<tf::Point> candidate_positions_;
+    std::vector<int> assignment_;
+};
+
+/**
+ * The leg detection pipeline of a single scanner without ROS communication: the candidates of a
+ * LegCandidateDetector go straight into a LegTracker. The caller provides the pose of the scanner,
+ * which is how leg_detection_node and the offline leg_detection_benchmark share the same code.
+ */
+class LegDetector
+{
+public:
+    typedef LegTracker::TrackList TrackList;
+    typedef LegDetectorParameters Parameters;
+
+    //! tracks are kept in fixed_frame
+    explicit LegDetector(const std::string& fixed_frame);
+
+    bool setForest(const FlatForest& forest)
+    {
+        return detector_.setForest(forest);
+    }
+
+    uint32_t getFeatureMask() const
+    {
+        return detector_.getFeatureMask();
+    }
+
+    void setParameters(const Parameters& params)
+    {
+        detector_.setParameters(params);
+    }
+
+    /** Detects the legs in the scan and updates the tracks, see LegCandidateDetector::detect() */
+    void processScan(const sensor_msgs::LaserScan& scan, const tf::Transform* scan_to_fixed, bool scanner_stationary);
+
+    const TrackList& getTracks() const
+    {
+        return tracker_.getTracks();
+    }
+
+    //! durations of the stages of the last scan
+    const LegDetectorTimings& getTimings() const
+    {
+        return timings_;
+    }
+
+    //! number of clusters of the last scan
+    size_t getNumClusters() const
+    {
+        return detector_.getNumClusters();
+    }
+
+    //! number of clusters of the last scan classified as leg
+    size_t getNumCandidates() const
+    {
+        return detector_.getCandidates().size();
+    }
+
+    //! whether all beams of the last scan were processed, see LegDetectorParameters::roi_enabled
+    bool wasFullScan() const
+    {
+        return detector_.wasFullScan();
+    }
+
+private:
+    LegCandidateDetector detector_;
+    LegTracker tracker_;
+    std::vector<tf::Point> track_positions_;
+    LegDetectorTimings timings_;
+};
+
+#endif  // MCR_LEG_DETECTION_LEG_DETECTOR_H
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2018 Bonn-Rhein-Sieg University
+ */
+#ifndef MCR_LEG_DETECTION_TRACK_ASSOCIATION_H
+#define MCR_LEG_DETECTION_TRACK_ASSOCIATION_H
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include <tf/transform_datatypes.h>
+
+namespace estimation
+{
+
+/**
+ * Assigns detections to tracks such that as many detections as possible are assigned to a
+ * track closer than the gate, and the sum of the distances of the assigned pairs is minimal.
+ *
+ * The tracks are bucketed in a grid with the gate as cell size, so every detection only
+ * looks at the tracks of the 3x3 cells around it. The gated pairs split into independent
+ * groups of nearby detections and tracks, and the optimal assignment is solved for every
+ * group on its own with the Hungarian method.
+ */
+class TrackAssociation
+{
+public:
+    /* gate in meters, detections and tracks further apart are never associated */
+    explicit TrackAssociation(double gate);
+
+    /**
+     * Fills assignment with the index of the track assigned to every detection, or -1 for a
+     * detection without a track. Every track is assigned to at most one detection.
+     */
+    void associate(const std::vector<tf::Point>& tracks, const std::vector<tf::Point>& detections,
+                   std::vector<int>& assignment);
+
+private:
+    struct Pair
+    {
+        int detection;
+        int track;
+        double distance;
+    };
+
+    double gate_;
+
+    // grid of the tracks as (cell, track) sorted by cell
+    std::vector<std::pair<int64_t, int> > grid_;
+    std::vector<Pair> pairs_;
+
+    // union find over detections [0, D) and tracks [D, D + T), giving the independent groups
+    std::vector<int> group_parent_;
+    std::vector<int> group_index_;
+    std::vector<std::vector<int> > group_pairs_;
+
+    // cost matrix and state of the Hungarian method
+    std::vector<int> rows_;
+    std::vector<int> cols_;
+    std::vector<double> cost_;
+    std::vector<double> row_potential_;
+    std::vector<double> col_potential_;
+    std::vector<double> min_slack_;
+    std::vector<int> col_match_;
+    std::vector<int> col_way_;
+    std::vector<char> col_used_;
+
+    int64_t cellKey(int64_t cx, int64_t cy) const;
+    int findGroup(int node);
+
+    void solveGroup(const std::vector<int>& pair_indices, std::vector<int>& assignment);
+
+    /** Minimum cost assignment of every row of the num_rows x num_cols cost_ matrix
+      * (num_rows <= num_cols). Afterwards col_match_[c + 1] is the row (+ 1) assigned to column c. */
+    void solveHungarian(int num_rows, int num_cols);
+};
+
+}  // namespace estimation
+
+#endif  // MCR_LEG_DETECTION_TRACK_ASSOCIATION_H
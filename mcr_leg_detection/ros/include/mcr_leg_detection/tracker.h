@@ -40,7 +40,7 @@
 #include "mcr_leg_detection/state_pos_vel.h"
 #include "mcr_leg_detection/PositionMeasurement.h"
 
-#include <bfl/wrappers/matrix/matrix_wrapper.h>
+#include <Eigen/Core>
 #include <string>
 
 
@@ -80,7 +80,7 @@ public:
     /// update tracker
     virtual bool updatePrediction(const double time) = 0;
     virtual bool updateCorrection(const tf::Vector3& meas,
-                                  const MatrixWrapper::SymmetricMatrix& cov) = 0;
+                                  const Eigen::Matrix3d& cov) = 0;
 
     /// get filter posterior
     virtual void getEstimate(BFL::StatePosVel& est) const = 0;
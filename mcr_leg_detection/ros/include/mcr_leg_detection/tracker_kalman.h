@@ -34,14 +34,15 @@
 
 /* Author: Wim Meeussen */
 
+
 #ifndef __TRACKER_KALMAN__
 #define __TRACKER_KALMAN__
 
-// bayesian filtering
-#include <bfl/filter/extendedkalmanfilter.h>
-#include <bfl/model/linearanalyticsystemmodel_gaussianuncertainty.h>
-#include <bfl/model/linearanalyticmeasurementmodel_gaussianuncertainty.h>
-#include <bfl/pdf/linearanalyticconditionalgaussian.h>
+#include <algorithm>
+#include <math.h>
+
+#include <Eigen/Core>
+#include <Eigen/Cholesky>
 
 #include "mcr_leg_detection/tracker.h"
 #include "mcr_leg_detection/state_pos_vel.h"
@@ -49,23 +50,62 @@
 // TF
 #include <tf/tf.h>
 
-// log files
-#include <fstream>
-
 namespace estimation
 {
 
+const double damping_velocity = 0.9;
+
+/// Constant velocity Kalman filter on fixed size matrices, the state is (position, velocity).
+/// The velocity is damped in every prediction step.
 class TrackerKalman: public Tracker
 {
 public:
+    typedef Eigen::Matrix<double, 6, 1> StateVector;
+    typedef Eigen::Matrix<double, 6, 6> StateMatrix;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
     /// constructor
-    TrackerKalman(const std::string& name, const BFL::StatePosVel& sysnoise);
+    TrackerKalman(const std::string& name, const BFL::StatePosVel& sysnoise)
+        : Tracker(name),
+          tracker_initialized_(false),
+          init_time_(0),
+          filter_time_(0),
+          quality_(0)
+    {
+        state_.setZero();
+        covariance_.setZero();
+
+        // the system noise per second, scaled with dt^2 in every prediction
+        sys_sigma_.setZero();
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            sys_sigma_(i) = pow(sysnoise.pos_[i], 2);
+            sys_sigma_(i + 3) = pow(sysnoise.vel_[i], 2);
+        }
+    }
 
     /// destructor
-    virtual ~TrackerKalman();
+    virtual ~TrackerKalman() {}
 
     /// initialize tracker
-    virtual void initialize(const BFL::StatePosVel& mu, const BFL::StatePosVel& sigma, const double time);
+    virtual void initialize(const BFL::StatePosVel& mu, const BFL::StatePosVel& sigma, const double time)
+    {
+        covariance_.setZero();
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            state_(i) = mu.pos_[i];
+            state_(i + 3) = mu.vel_[i];
+            covariance_(i, i) = pow(sigma.pos_[i], 2);
+            covariance_(i + 3, i + 3) = pow(sigma.vel_[i], 2);
+        }
+
+        // tracker initialized
+        tracker_initialized_ = true;
+        quality_ = 1;
+        filter_time_ = time;
+        init_time_ = time;
+    }
 
     /// return if tracker was initialized
     virtual bool isInitialized() const
@@ -80,33 +120,106 @@ public:
     };
 
     /// return the lifetime of the tracker
-    virtual double getLifetime() const;
+    virtual double getLifetime() const
+    {
+        if (tracker_initialized_)
+            return filter_time_ - init_time_;
+        else
+            return 0;
+    }
 
     /// return the time of the tracker
-    virtual double getTime() const;
+    virtual double getTime() const
+    {
+        if (tracker_initialized_)
+            return filter_time_;
+        else
+            return 0;
+    }
 
     /// update tracker
-    virtual bool updatePrediction(const double time);
-    virtual bool updateCorrection(const tf::Vector3& meas,
-                                  const MatrixWrapper::SymmetricMatrix& cov);
+    virtual bool updatePrediction(const double time)
+    {
+        if (time <= filter_time_)
+            return true;
+
+        double dt = time - filter_time_;
+        filter_time_ = time;
+
+        // x = A x with A = [I dt*I; 0 damping*I]
+        state_.head<3>() += dt * state_.tail<3>();
+        state_.tail<3>() *= damping_velocity;
+
+        // P = A P A^T + Q * dt^2, with A applied as row and column operations
+        covariance_.topRows<3>() += dt * covariance_.bottomRows<3>();
+        covariance_.bottomRows<3>() *= damping_velocity;
+        covariance_.leftCols<3>() += dt * covariance_.rightCols<3>();
+        covariance_.rightCols<3>() *= damping_velocity;
+        covariance_.diagonal() += sys_sigma_ * (dt * dt);
+
+        quality_ = calculateQuality();
+        return true;
+    }
+
+    virtual bool updateCorrection(const tf::Vector3& meas, const Eigen::Matrix3d& cov)
+    {
+        // the measurement is the position, H = [I 0]
+        Eigen::Vector3d innovation;
+        for (unsigned int i = 0; i < 3; i++)
+            innovation(i) = meas[i] - state_(i);
+
+        Eigen::Matrix3d innovation_cov = covariance_.topLeftCorner<3, 3>() + cov;
+        Eigen::LDLT<Eigen::Matrix3d> solver(innovation_cov);
+        if (solver.info() != Eigen::Success)
+        {
+            quality_ = 0;
+            return false;
+        }
+
+        // K = P H^T S^-1, i.e. the left columns of P times S^-1
+        Eigen::Matrix<double, 6, 3> gain = solver.solve(covariance_.leftCols<3>().transpose()).transpose();
+
+        state_ += gain * innovation;
+
+        // P = (I - K H) P
+        StateMatrix correction = gain * covariance_.topRows<3>();
+        covariance_ -= correction;
+
+        quality_ = calculateQuality();
+        return true;
+    }
 
     /// get filter posterior
-    virtual void getEstimate(BFL::StatePosVel& est) const;
-    virtual void getEstimate(mcr_leg_detection::PositionMeasurement& est) const;
+    virtual void getEstimate(BFL::StatePosVel& est) const
+    {
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            est.pos_[i] = state_(i);
+            est.vel_[i] = state_(i + 3);
+        }
+    }
+
+    virtual void getEstimate(mcr_leg_detection::PositionMeasurement& est) const
+    {
+        est.pos.x = state_(0);
+        est.pos.y = state_(1);
+        est.pos.z = state_(2);
 
+        est.header.stamp.fromSec(filter_time_);
+        est.object_id = getName();
+    }
 
 private:
-    // pdf / model / filter
-    BFL::Gaussian                                           prior_;
-    BFL::ExtendedKalmanFilter*                              filter_;
-    BFL::LinearAnalyticConditionalGaussian*                 sys_pdf_;
-    BFL::LinearAnalyticSystemModelGaussianUncertainty*      sys_model_;
-    BFL::LinearAnalyticConditionalGaussian*                 meas_pdf_;
-    BFL::LinearAnalyticMeasurementModelGaussianUncertainty* meas_model_;
-    MatrixWrapper::Matrix                                   sys_matrix_;
-    MatrixWrapper::SymmetricMatrix                          sys_sigma_;
-
-    double calculateQuality();
+    StateVector state_;
+    StateMatrix covariance_;
+    StateVector sys_sigma_;
+
+    double calculateQuality() const
+    {
+        double sigma_max = std::max(sqrt(covariance_(0, 0)), sqrt(covariance_(1, 1)));
+
+        return 1.0 - std::min(1.0, sigma_max / 1.5);
+    }
 
     // vars
     bool tracker_initialized_;
@@ -34,313 +34,360 @@
 
 #include "mcr_leg_detection/calc_leg_features.h"
 
-#include <opencv/cxcore.h>
-#include <opencv/cv.h>
+#include <algorithm>
+#include <vector>
 
 using namespace laser_processor;
 using namespace std;
 
-vector<float> calcLegFeatures(SampleSet* cluster, const sensor_msgs::LaserScan& scan)
+namespace
 {
+//! Clusters up to this size keep the coordinates for their medians on the stack
+const int MAX_STACK_SAMPLES = 256;
 
-    vector<float> features;
+//! Median of values, which is partially reordered
+float median(float* values, int num_values)
+{
+    float* upper = values + num_values / 2;
+    nth_element(values, upper, values + num_values);
+
+    // for an even number of values, the lower one of the two middle values is the largest
+    // value of the lower half
+    float lower = (num_values % 2 == 0) ? *max_element(values, upper) : *upper;
 
+    return 0.5 * (lower + *upper);
+}
+
+//! Whether the mask contains any of the features first to last
+inline bool needsAny(uint32_t feature_mask, int first, int last)
+{
+    return (feature_mask >> first) & ((1u << (last - first + 1)) - 1);
+}
+}
+
+void calcLegFeatures(const SampleSet& cluster, const CartesianScan& scan, float* features, uint32_t feature_mask)
+{
     // Number of points
-    int num_points = cluster->size();
-    //  features.push_back(num_points);
+    int num_points = cluster.size();
 
     // Compute mean and median points for future use
     float x_mean = 0.0;
     float y_mean = 0.0;
-    vector<float> x_median_set;
-    vector<float> y_median_set;
-    for (SampleSet::iterator i = cluster->begin();
-            i != cluster->end();
-            i++)
 
+    bool median_needed = needsAny(feature_mask, 1, 1);
+
+    float x_stack[MAX_STACK_SAMPLES];
+    float y_stack[MAX_STACK_SAMPLES];
+    vector<float> median_heap;
+    float* x_median_set = x_stack;
+    float* y_median_set = y_stack;
+    if (median_needed && num_points > MAX_STACK_SAMPLES)
     {
-        x_mean += ((*i)->x) / num_points;
-        y_mean += ((*i)->y) / num_points;
-        x_median_set.push_back((*i)->x);
-        y_median_set.push_back((*i)->y);
+        median_heap.resize(2 * num_points);
+        x_median_set = &median_heap[0];
+        y_median_set = &median_heap[num_points];
     }
 
-    std::sort(x_median_set.begin(), x_median_set.end());
-    std::sort(y_median_set.begin(), y_median_set.end());
+    {
+        int j = 0;
+        for (SampleSet::iterator i = cluster.begin(); i != cluster.end(); i++, j++)
+        {
+            x_mean += (i->x) / num_points;
+            y_mean += (i->y) / num_points;
+            if (median_needed)
+            {
+                x_median_set[j] = i->x;
+                y_median_set[j] = i->y;
+            }
+        }
+    }
 
-    float x_median = 0.5 * (*(x_median_set.begin() + (num_points - 1) / 2) + * (x_median_set.begin() + num_points / 2));
-    float y_median = 0.5 * (*(y_median_set.begin() + (num_points - 1) / 2) + * (y_median_set.begin() + num_points / 2));
+    float x_median = 0.0;
+    float y_median = 0.0;
+    if (median_needed)
+    {
+        x_median = median(x_median_set, num_points);
+        y_median = median(y_median_set, num_points);
+    }
 
-    //Compute std and avg diff from median
+    // Compute std and avg diff from median, together with the scatter matrix of the points
+    // around the mean which is used for the linearity
 
-    double sum_std_diff = 0.0;
     double sum_med_diff = 0.0;
+    double sxx = 0.0;
+    double sxy = 0.0;
+    double syy = 0.0;
 
-
-    for (SampleSet::iterator i = cluster->begin();
-            i != cluster->end();
-            i++)
-
+    if (needsAny(feature_mask, 0, 1) || needsAny(feature_mask, 5, 5))
     {
-        sum_std_diff += pow((*i)->x - x_mean, 2) + pow((*i)->y - y_mean, 2);
-        sum_med_diff += sqrt(pow((*i)->x - x_median, 2) + pow((*i)->y - y_median, 2));
+        for (SampleSet::iterator i = cluster.begin(); i != cluster.end(); i++)
+        {
+            double dx = i->x - x_mean;
+            double dy = i->y - y_mean;
+            sxx += dx * dx;
+            sxy += dx * dy;
+            syy += dy * dy;
+
+            if (median_needed)
+            {
+                double mx = i->x - x_median;
+                double my = i->y - y_median;
+                sum_med_diff += sqrt(mx * mx + my * my);
+            }
+        }
     }
+    double sum_std_diff = sxx + syy;
 
     float std = sqrt(1.0 / (num_points - 1.0) * sum_std_diff);
     float avg_median_dev = sum_med_diff / num_points;
 
-    features.push_back(std);
-    features.push_back(avg_median_dev);
+    features[0] = std;
+    features[1] = avg_median_dev;
 
 
     // Take first at last
-    SampleSet::iterator first = cluster->begin();
-    SampleSet::iterator last = cluster->end();
+    SampleSet::iterator first = cluster.begin();
+    SampleSet::iterator last = cluster.end();
     last--;
 
+
     // Compute Jump distance
-    int prev_ind = (*first)->index - 1;
-    int next_ind = (*last)->index + 1;
+    if (needsAny(feature_mask, 2, 3))
+    {
+        int prev_ind = first->index - 1;
+        int next_ind = last->index + 1;
 
-    float prev_jump = 0;
-    float next_jump = 0;
+        float prev_jump = 0;
+        float next_jump = 0;
 
-    if (prev_ind >= 0)
-    {
-        Sample* prev = Sample::Extract(prev_ind, scan);
-        if (prev)
+        Sample neighbour;
+
+        if (prev_ind >= 0)
         {
-            prev_jump = sqrt(pow((*first)->x - prev->x, 2) + pow((*first)->y - prev->y, 2));
-            delete prev;
+            if (Sample::Extract(prev_ind, scan, neighbour))
+                prev_jump = sqrt(pow(first->x - neighbour.x, 2) + pow(first->y - neighbour.y, 2));
         }
 
-    }
-
-    if (next_ind < (int)scan.ranges.size())
-    {
-        Sample* next = Sample::Extract(next_ind, scan);
-        if (next)
+        if (next_ind < (int)scan.size())
         {
-            next_jump = sqrt(pow((*last)->x - next->x, 2) + pow((*last)->y - next->y, 2));
-            delete next;
+            if (Sample::Extract(next_ind, scan, neighbour))
+                next_jump = sqrt(pow(last->x - neighbour.x, 2) + pow(last->y - neighbour.y, 2));
         }
-    }
 
-    features.push_back(prev_jump);
-    features.push_back(next_jump);
+        features[2] = prev_jump;
+        features[3] = next_jump;
+    }
 
     // Compute Width
-    float width = sqrt(pow((*first)->x - (*last)->x, 2) + pow((*first)->y - (*last)->y, 2));
-    features.push_back(width);
+    float width = sqrt(pow(first->x - last->x, 2) + pow(first->y - last->y, 2));
+    features[4] = width;
 
     // Compute Linearity
+    // The sum of the squared distances of the points to their principal axis, i.e. the smaller
+    // eigenvalue of the 2x2 scatter matrix. The product of both eigenvalues is the determinant,
+    // which avoids the cancellation of the direct formula when the points are almost collinear.
+    double half_trace = 0.5 * (sxx + syy);
+    double half_diff = 0.5 * (sxx - syy);
+    double eigen_max = half_trace + sqrt(half_diff * half_diff + sxy * sxy);
+    double eigen_min = (eigen_max > 0.0) ? max(0.0, (sxx * syy - sxy * sxy) / eigen_max) : 0.0;
 
-    CvMat* points = cvCreateMat(num_points, 2, CV_64FC1);
+    float linearity = eigen_min;
+
+    features[5] = linearity;
+
+    // Compute Circularity
+    if (needsAny(feature_mask, 6, 7))
     {
-        int j = 0;
-        for (SampleSet::iterator i = cluster->begin();
-                i != cluster->end();
-                i++)
+        // Least squares fit of x^2 + y^2 = 2 * xc * x + 2 * yc * y + (rc^2 - xc^2 - yc^2) through the
+        // normal equations. The fit does not depend on the origin, so the points are taken relative
+        // to their mean to keep the 3x3 system well conditioned.
+        double su = 0.0, sv = 0.0, suu = 0.0, suv = 0.0, svv = 0.0;
+        double sw = 0.0, suw = 0.0, svw = 0.0;
+        for (SampleSet::iterator i = cluster.begin(); i != cluster.end(); i++)
         {
-            cvmSet(points, j, 0, (*i)->x - x_mean);
-            cvmSet(points, j, 1, (*i)->y - y_mean);
-            j++;
+            double u = i->x - x_mean;
+            double v = i->y - y_mean;
+            double w = u * u + v * v;
+            su += u;
+            sv += v;
+            suu += u * u;
+            suv += u * v;
+            svv += v * v;
+            sw += w;
+            suw += u * w;
+            svw += v * w;
         }
-    }
-
-    CvMat* W = cvCreateMat(2, 2, CV_64FC1);
-    CvMat* U = cvCreateMat(num_points, 2, CV_64FC1);
-    CvMat* V = cvCreateMat(2, 2, CV_64FC1);
-    cvSVD(points, W, U, V);
-
-    CvMat* rot_points = cvCreateMat(num_points, 2, CV_64FC1);
-    cvMatMul(U, W, rot_points);
 
-    float linearity = 0.0;
-    for (int i = 0; i < num_points; i++)
-    {
-        linearity += pow(cvmGet(rot_points, i, 1), 2);
-    }
+        // Solve the normal equations [2suu 2suv su; 2suv 2svv sv; 2su 2sv n] * [a b c]^T = [suw svw sw]^T
+        // with Cramer's rule, where (a, b) is the center relative to the mean and c = rc^2 - a^2 - b^2.
+        // Collinear points have no circle, their center stays at the mean with a radius of zero.
+        double n = num_points;
+        double m00 = 2.0 * suu, m01 = 2.0 * suv, m02 = su;
+        double m10 = 2.0 * suv, m11 = 2.0 * svv, m12 = sv;
+        double m20 = 2.0 * su,  m21 = 2.0 * sv,  m22 = n;
 
-    cvReleaseMat(&points);
-    points = 0;
-    cvReleaseMat(&W);
-    W = 0;
-    cvReleaseMat(&U);
-    U = 0;
-    cvReleaseMat(&V);
-    V = 0;
-    cvReleaseMat(&rot_points);
-    rot_points = 0;
+        double c00 = m11 * m22 - m12 * m21;
+        double c01 = m12 * m20 - m10 * m22;
+        double c02 = m10 * m21 - m11 * m20;
+        double det = m00 * c00 + m01 * c01 + m02 * c02;
 
-    features.push_back(linearity);
+        float xc = x_mean;
+        float yc = y_mean;
+        float rc = 0.0;
 
-    // Compute Circularity
-    CvMat* A = cvCreateMat(num_points, 3, CV_64FC1);
-    CvMat* B = cvCreateMat(num_points, 1, CV_64FC1);
-    {
-        int j = 0;
-        for (SampleSet::iterator i = cluster->begin();
-                i != cluster->end();
-                i++)
+        if (det != 0.0)
         {
-            float x = (*i)->x;
-            float y = (*i)->y;
+            double a = (suw * c00 + m01 * (m12 * sw - svw * m22) + m02 * (svw * m21 - m11 * sw)) / det;
+            double b = (m00 * (svw * m22 - m12 * sw) + suw * c01 + m02 * (m10 * sw - svw * m20)) / det;
+            double c = (m00 * (m11 * sw - svw * m21) + m01 * (svw * m20 - m10 * sw) + suw * c02) / det;
 
-            cvmSet(A, j, 0, -2.0 * x);
-            cvmSet(A, j, 1, -2.0 * y);
-            cvmSet(A, j, 2, 1);
+            xc = a + x_mean;
+            yc = b + y_mean;
+            rc = sqrt(a * a + b * b + c);
+        }
 
-            cvmSet(B, j, 0, -pow(x, 2) - pow(y, 2));
-            j++;
+        float circularity = 0.0;
+        if (needsAny(feature_mask, 6, 6))
+        {
+            for (SampleSet::iterator i = cluster.begin(); i != cluster.end(); i++)
+            {
+                circularity += pow(rc - sqrt(pow(xc - i->x, 2) + pow(yc - i->y, 2)), 2);
+            }
         }
-    }
-    CvMat* sol = cvCreateMat(3, 1, CV_64FC1);
 
-    cvSolve(A, B, sol, CV_SVD);
+        features[6] = circularity;
 
-    float xc = cvmGet(sol, 0, 0);
-    float yc = cvmGet(sol, 1, 0);
-    float rc = sqrt(pow(xc, 2) + pow(yc, 2) - cvmGet(sol, 2, 0));
+        // Radius
+        float radius = rc;
 
-    cvReleaseMat(&A);
-    A = 0;
-    cvReleaseMat(&B);
-    B = 0;
-    cvReleaseMat(&sol);
-    sol = 0;
+        features[7] = radius;
+    }
 
-    float circularity = 0.0;
-    for (SampleSet::iterator i = cluster->begin();
-            i != cluster->end();
-            i++)
+    // Boundary length, mean angular difference, curvature and boundary regularity
+    if (needsAny(feature_mask, 8, 11))
     {
-        circularity += pow(rc - sqrt(pow(xc - (*i)->x, 2) + pow(yc - (*i)->y, 2)), 2);
-    }
+        //Curvature:
+        float mean_curvature = 0.0;
 
-    features.push_back(circularity);
+        //Boundary length:
+        float boundary_length = 0.0;
+        float last_boundary_seg = 0.0;
 
-    // Radius
-    float radius = rc;
+        float boundary_regularity = 0.0;
+        double sum_boundary_reg_sq = 0.0;
 
-    features.push_back(radius);
+        // Mean angular difference
+        SampleSet::iterator left = cluster.begin();
+        left++;
+        left++;
+        SampleSet::iterator mid = cluster.begin();
+        mid++;
+        SampleSet::iterator right = cluster.begin();
 
-    //Curvature:
-    float mean_curvature = 0.0;
+        float ang_diff = 0.0;
 
-    //Boundary length:
-    float boundary_length = 0.0;
-    float last_boundary_seg = 0.0;
+        while (left != cluster.end())
+        {
+            float mlx = left->x - mid->x;
+            float mly = left->y - mid->y;
+            float L_ml = sqrt(mlx * mlx + mly * mly);
 
-    float boundary_regularity = 0.0;
-    double sum_boundary_reg_sq = 0.0;
+            float mrx = right->x - mid->x;
+            float mry = right->y - mid->y;
+            float L_mr = sqrt(mrx * mrx + mry * mry);
 
-    // Mean angular difference
-    SampleSet::iterator left = cluster->begin();
-    left++;
-    left++;
-    SampleSet::iterator mid = cluster->begin();
-    mid++;
-    SampleSet::iterator right = cluster->begin();
+            float lrx = left->x - right->x;
+            float lry = left->y - right->y;
+            float L_lr = sqrt(lrx * lrx + lry * lry);
 
-    float ang_diff = 0.0;
+            boundary_length += L_mr;
+            sum_boundary_reg_sq += L_mr * L_mr;
+            last_boundary_seg = L_ml;
 
-    while (left != cluster->end())
-    {
-        float mlx = (*left)->x - (*mid)->x;
-        float mly = (*left)->y - (*mid)->y;
-        float L_ml = sqrt(mlx * mlx + mly * mly);
+            float A = (mlx * mrx + mly * mry) / pow(L_mr, 2);
+            float B = (mlx * mry - mly * mrx) / pow(L_mr, 2);
 
-        float mrx = (*right)->x - (*mid)->x;
-        float mry = (*right)->y - (*mid)->y;
-        float L_mr = sqrt(mrx * mrx + mry * mry);
+            float th = atan2(B, A);
 
-        float lrx = (*left)->x - (*right)->x;
-        float lry = (*left)->y - (*right)->y;
-        float L_lr = sqrt(lrx * lrx + lry * lry);
+            if (th < 0)
+                th += 2 * M_PI;
 
-        boundary_length += L_mr;
-        sum_boundary_reg_sq += L_mr * L_mr;
-        last_boundary_seg = L_ml;
+            ang_diff += th / num_points;
 
-        float A = (mlx * mrx + mly * mry) / pow(L_mr, 2);
-        float B = (mlx * mry - mly * mrx) / pow(L_mr, 2);
+            float s = 0.5 * (L_ml + L_mr + L_lr);
+            float area = sqrt(s * (s - L_ml) * (s - L_mr) * (s - L_lr));
 
-        float th = atan2(B, A);
+            if (th > 0)
+                mean_curvature += 4 * (area) / (L_ml * L_mr * L_lr * num_points);
+            else
+                mean_curvature -= 4 * (area) / (L_ml * L_mr * L_lr * num_points);
 
-        if (th < 0)
-            th += 2 * M_PI;
+            left++;
+            mid++;
+            right++;
+        }
 
-        ang_diff += th / num_points;
+        boundary_length += last_boundary_seg;
+        sum_boundary_reg_sq += last_boundary_seg * last_boundary_seg;
 
-        float s = 0.5 * (L_ml + L_mr + L_lr);
-        float area = sqrt(s * (s - L_ml) * (s - L_mr) * (s - L_lr));
+        boundary_regularity = sqrt((sum_boundary_reg_sq - pow(boundary_length, 2) / num_points) / (num_points - 1));
 
-        if (th > 0)
-            mean_curvature += 4 * (area) / (L_ml * L_mr * L_lr * num_points);
-        else
-            mean_curvature -= 4 * (area) / (L_ml * L_mr * L_lr * num_points);
+        features[8] = boundary_length;
+        features[9] = ang_diff;
+        features[10] = mean_curvature;
 
-        left++;
-        mid++;
-        right++;
+        features[11] = boundary_regularity;
     }
 
-    boundary_length += last_boundary_seg;
-    sum_boundary_reg_sq += last_boundary_seg * last_boundary_seg;
-
-    boundary_regularity = sqrt((sum_boundary_reg_sq - pow(boundary_length, 2) / num_points) / (num_points - 1));
 
-    features.push_back(boundary_length);
-    features.push_back(ang_diff);
-    features.push_back(mean_curvature);
-
-    features.push_back(boundary_regularity);
+    // Inscribed angle variance
+    if (needsAny(feature_mask, 12, 13))
+    {
+        SampleSet::iterator mid = cluster.begin();
+        mid++;
 
+        double sum_iav = 0.0;
+        double sum_iav_sq  = 0.0;
 
-    // Mean angular difference
-    first = cluster->begin();
-    mid = cluster->begin();
-    mid++;
-    last = cluster->end();
-    last--;
+        while (mid != last)
+        {
+            float mlx = first->x - mid->x;
+            float mly = first->y - mid->y;
+            //float L_ml = sqrt(mlx*mlx + mly*mly);
 
-    double sum_iav = 0.0;
-    double sum_iav_sq  = 0.0;
+            float mrx = last->x - mid->x;
+            float mry = last->y - mid->y;
+            float L_mr = sqrt(mrx * mrx + mry * mry);
 
-    while (mid != last)
-    {
-        float mlx = (*first)->x - (*mid)->x;
-        float mly = (*first)->y - (*mid)->y;
-        //float L_ml = sqrt(mlx*mlx + mly*mly);
+            //float lrx = first->x - last->x;
+            //float lry = first->y - last->y;
+            //float L_lr = sqrt(lrx*lrx + lry*lry);
 
-        float mrx = (*last)->x - (*mid)->x;
-        float mry = (*last)->y - (*mid)->y;
-        float L_mr = sqrt(mrx * mrx + mry * mry);
+            float A = (mlx * mrx + mly * mry) / pow(L_mr, 2);
+            float B = (mlx * mry - mly * mrx) / pow(L_mr, 2);
 
-        //float lrx = (*first)->x - (*last)->x;
-        //float lry = (*first)->y - (*last)->y;
-        //float L_lr = sqrt(lrx*lrx + lry*lry);
+            float th = atan2(B, A);
 
-        float A = (mlx * mrx + mly * mry) / pow(L_mr, 2);
-        float B = (mlx * mry - mly * mrx) / pow(L_mr, 2);
+            if (th < 0)
+                th += 2 * M_PI;
 
-        float th = atan2(B, A);
+            sum_iav += th;
+            sum_iav_sq += th * th;
 
-        if (th < 0)
-            th += 2 * M_PI;
+            mid++;
+        }
 
-        sum_iav += th;
-        sum_iav_sq += th * th;
+        float iav = sum_iav / num_points;
+        float std_iav = sqrt((sum_iav_sq - pow(sum_iav, 2) / num_points) / (num_points - 1));
 
-        mid++;
+        features[12] = iav;
+        features[13] = std_iav;
     }
 
-    float iav = sum_iav / num_points;
-    float std_iav = sqrt((sum_iav_sq - pow(sum_iav, 2) / num_points) / (num_points - 1));
-
-    features.push_back(iav);
-    features.push_back(std_iav);
-
-    return features;
+    // The features the forest does not use are zero, whether they were computed or not
+    for (int f = 0; f < LEG_FEATURE_COUNT; f++)
+    {
+        if (!(feature_mask & (1u << f)))
+            features[f] = 0.0;
+    }
 }
@@ -0,0 +1,310 @@
+/*
+ * Copyright 2018 Bonn-Rhein-Sieg University
+ */
+#include "mcr_leg_detection/flat_forest.h"
+
+#include <ctype.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+
+using namespace std;
+
+namespace
+{
+// the value cv::ml::TrainData uses for missing values
+const float MISSING_VALUE = FLT_MAX;
+
+// number of samples load() compares with RTrees::predict
+const int NUM_PROBE_SAMPLES = 256;
+
+/** Appends the subtree below the OpenCV node index in depth first order, so the left child of
+  * a node directly follows it. Returns the index of the flattened node. */
+int32_t flattenNode(int index, const vector<cv::ml::DTrees::Node>& nodes, const vector<cv::ml::DTrees::Split>& splits,
+                    vector<FlatForest::Node>& flat, vector<float>& class_labels, bool& supported)
+{
+    const cv::ml::DTrees::Node& node = nodes[index];
+    int32_t flat_index = flat.size();
+    flat.push_back(FlatForest::Node());
+
+    if (node.split < 0)
+    {
+        if (node.classIdx < 0)
+        {
+            supported = false;
+            return flat_index;
+        }
+
+        FlatForest::Node leaf = { -1, 0.0f, { node.classIdx, node.classIdx }, node.classIdx };
+        flat[flat_index] = leaf;
+
+        // the value of a leaf of a classifier is its class label
+        if (class_labels.size() <= static_cast<size_t>(node.classIdx))
+            class_labels.resize(node.classIdx + 1, 0.0f);
+        class_labels[node.classIdx] = static_cast<float>(node.value);
+
+        return flat_index;
+    }
+
+    const cv::ml::DTrees::Split& split = splits[node.split];
+
+    // splits of categorical variables test a subset of categories
+    if (split.subsetOfs >= 0)
+    {
+        supported = false;
+        return flat_index;
+    }
+
+    int32_t left = flattenNode(node.left, nodes, splits, flat, class_labels, supported);
+    int32_t right = flattenNode(node.right, nodes, splits, flat, class_labels, supported);
+
+    // an inversed split sends the samples <= c to the right, missing values still follow defaultDir
+    int32_t lower = split.inversed ? right : left;
+    int32_t upper = split.inversed ? left : right;
+
+    FlatForest::Node inner = { split.varIdx, split.c, { lower, upper }, (node.defaultDir < 0) ? left : right };
+    flat[flat_index] = inner;
+
+    return flat_index;
+}
+}
+
+FlatForest::FlatForest()
+    : nodes_(NULL), num_nodes_(0), roots_(NULL), num_trees_(0), class_labels_(NULL), num_classes_(0), var_count_(0)
+{
+}
+
+FlatForest::FlatForest(const FlatForest& other)
+    : nodes_(NULL), num_nodes_(0), roots_(NULL), num_trees_(0), class_labels_(NULL), num_classes_(0), var_count_(0)
+{
+    *this = other;
+}
+
+FlatForest& FlatForest::operator=(const FlatForest& other)
+{
+    if (this == &other)
+        return *this;
+
+    node_storage_ = other.node_storage_;
+    root_storage_ = other.root_storage_;
+    class_label_storage_ = other.class_label_storage_;
+
+    if (!other.empty() && other.nodes_ == other.node_storage_.data())
+    {
+        assign(node_storage_.data(), node_storage_.size(), root_storage_.data(), root_storage_.size(),
+               class_label_storage_.data(), class_label_storage_.size());
+    }
+    else
+    {
+        assign(other.nodes_, other.num_nodes_, other.roots_, other.num_trees_, other.class_labels_,
+               other.num_classes_);
+    }
+
+    return *this;
+}
+
+bool FlatForest::load(const cv::ml::RTrees& forest)
+{
+    clear();
+
+    if (!forest.isTrained() || !forest.isClassifier())
+        return false;
+
+    const vector<int>& roots = forest.getRoots();
+    const vector<cv::ml::DTrees::Node>& nodes = forest.getNodes();
+    const vector<cv::ml::DTrees::Split>& splits = forest.getSplits();
+
+    bool supported = true;
+    for (size_t t = 0; t < roots.size() && supported; ++t)
+        root_storage_.push_back(flattenNode(roots[t], nodes, splits, node_storage_, class_label_storage_, supported));
+
+    if (supported && !root_storage_.empty())
+    {
+        assign(&node_storage_[0], node_storage_.size(), &root_storage_[0], root_storage_.size(),
+               &class_label_storage_[0], class_label_storage_.size());
+
+        // The splits index the variables of the training data, which are only the columns of the
+        // samples for models trained on all variables. RTrees does not expose the mapping or the
+        // substitutes of missing values, so the tables are checked against the model itself.
+        if (reproducesPrediction(forest))
+            return true;
+    }
+
+    clear();
+    return false;
+}
+
+void FlatForest::clear()
+{
+    node_storage_.clear();
+    root_storage_.clear();
+    class_label_storage_.clear();
+    assign(NULL, 0, NULL, 0, NULL, 0);
+}
+
+bool FlatForest::reproducesPrediction(const cv::ml::RTrees& forest) const
+{
+    int num_vars = forest.getVarCount();
+    if (var_count_ > num_vars)
+        return false;
+
+    // the thresholds of every variable, a probe value on either side of them takes both branches
+    vector<vector<float> > thresholds(num_vars);
+    for (size_t n = 0; n < num_nodes_; ++n)
+    {
+        if (nodes_[n].var >= 0)
+            thresholds[nodes_[n].var].push_back(nodes_[n].threshold);
+    }
+
+    cv::RNG rng(0x5eed);
+    cv::Mat samples(NUM_PROBE_SAMPLES, num_vars, CV_32FC1);
+    for (int s = 0; s < samples.rows; ++s)
+    {
+        float* sample = samples.ptr<float>(s);
+        for (int v = 0; v < num_vars; ++v)
+        {
+            if (rng(16) == 0)
+                sample[v] = MISSING_VALUE;
+            else if (thresholds[v].empty())
+                sample[v] = rng.uniform(-1.0f, 1.0f);
+            else
+            {
+                float threshold = thresholds[v][rng(thresholds[v].size())];
+                sample[v] = rng(2) ? threshold : nextafterf(threshold, FLT_MAX);
+            }
+        }
+    }
+
+    cv::Mat expected, responses;
+    forest.predict(samples, expected);
+    predict(samples, responses);
+
+    for (int s = 0; s < samples.rows; ++s)
+    {
+        if (expected.at<float>(s) != responses.at<float>(s))
+            return false;
+    }
+
+    return true;
+}
+
+void FlatForest::assign(const Node* nodes, size_t num_nodes, const int32_t* roots, size_t num_trees,
+                        const float* class_labels, size_t num_classes)
+{
+    nodes_ = nodes;
+    num_nodes_ = num_nodes;
+    roots_ = roots;
+    num_trees_ = num_trees;
+    class_labels_ = class_labels;
+    num_classes_ = num_classes;
+
+    var_count_ = 0;
+    for (size_t n = 0; n < num_nodes_; ++n)
+        var_count_ = max(var_count_, nodes_[n].var + 1);
+}
+
+void FlatForest::getVarUsage(vector<int>& num_splits) const
+{
+    num_splits.assign(var_count_, 0);
+    for (size_t n = 0; n < num_nodes_; ++n)
+    {
+        if (nodes_[n].var >= 0)
+            num_splits[nodes_[n].var]++;
+    }
+}
+
+int32_t FlatForest::findLeaf(int32_t node, const float* sample) const
+{
+    while (nodes_[node].var >= 0)
+    {
+        const Node& n = nodes_[node];
+        float value = sample[n.var];
+        node = (value == MISSING_VALUE) ? n.default_child : n.child[!(value <= n.threshold)];
+    }
+    return node;
+}
+
+float FlatForest::vote(const int* votes) const
+{
+    size_t best = 0;
+    for (size_t c = 1; c < num_classes_; ++c)
+    {
+        if (votes[best] < votes[c])
+            best = c;
+    }
+    return class_labels_[best];
+}
+
+float FlatForest::predict(const float* sample) const
+{
+    vector<int> votes(num_classes_, 0);
+    for (size_t t = 0; t < num_trees_; ++t)
+        votes[nodes_[findLeaf(roots_[t], sample)].child[0]]++;
+
+    return vote(&votes[0]);
+}
+
+void FlatForest::predict(const cv::Mat& samples, cv::Mat& responses) const
+{
+    CV_Assert(samples.type() == CV_32FC1 && samples.cols >= var_count_);
+
+    int num_samples = samples.rows;
+    responses.create(num_samples, 1, CV_32FC1);
+
+    vector<int> votes(num_samples * num_classes_, 0);
+
+    // tree by tree, so that only the nodes of one tree are needed at a time
+    for (size_t t = 0; t < num_trees_; ++t)
+    {
+        int32_t root = roots_[t];
+        for (int s = 0; s < num_samples; ++s)
+            votes[s * num_classes_ + nodes_[findLeaf(root, samples.ptr<float>(s))].child[0]]++;
+    }
+
+    for (int s = 0; s < num_samples; ++s)
+        responses.at<float>(s) = vote(&votes[s * num_classes_]);
+}
+
+void FlatForest::writeCode(ostream& out, const string& name_space, const string& comment) const
+{
+    char buffer[128];
+
+    string guard = name_space + "_H";
+    transform(guard.begin(), guard.end(), guard.begin(), ::toupper);
+
+    out << "// " << comment << "\n"
+        << "// Generated by leg_forest_codegen, do not edit.\n"
+        << "#ifndef " << guard << "\n"
+        << "#define " << guard << "\n\n"
+        << "#include <stdint.h>\n"
+        << "#include \"mcr_leg_detection/flat_forest.h\"\n\n"
+        << "namespace " << name_space << "\n{\n";
+
+    // floats are written with 9 significant digits, which restores them exactly
+    out << "constexpr FlatForest::Node nodes[] =\n{\n";
+    for (size_t n = 0; n < num_nodes_; ++n)
+    {
+        const Node& node = nodes_[n];
+        snprintf(buffer, sizeof(buffer), "    { %d, %.8ef, { %d, %d }, %d },\n",
+                 node.var, node.threshold, node.child[0], node.child[1], node.default_child);
+        out << buffer;
+    }
+    out << "};\n\n";
+
+    out << "constexpr int32_t roots[] =\n{\n";
+    for (size_t t = 0; t < num_trees_; ++t)
+        out << "    " << roots_[t] << ",\n";
+    out << "};\n\n";
+
+    out << "constexpr float class_labels[] =\n{\n";
+    for (size_t c = 0; c < num_classes_; ++c)
+    {
+        snprintf(buffer, sizeof(buffer), "    %.8ef,\n", class_labels_[c]);
+        out << buffer;
+    }
+    out << "};\n";
+
+    out << "}  // namespace " << name_space << "\n\n"
+        << "#endif  // " << guard << "\n";
+}
@@ -34,41 +34,27 @@
 
 #include "mcr_leg_detection/laser_processor.h"
 
-#include <stdexcept>
+#include <limits>
 
 using namespace ros;
 using namespace std;
 using namespace laser_processor;
 
-Sample* Sample::Extract(int ind, const sensor_msgs::LaserScan& scan)
+bool Sample::Extract(int ind, const CartesianScan& scan, Sample& sample)
 {
-    Sample* s = new Sample();
-
-    s->index = ind;
-    s->range = scan.ranges[ind];
-    s->x = cos(scan.angle_min + ind * scan.angle_increment) * s->range;
-    s->y = sin(scan.angle_min + ind * scan.angle_increment) * s->range;
-    if (s->range > scan.range_min && s->range < scan.range_max)
-        return s;
-    else
-    {
-        delete s;
-        return NULL;
-    }
-}
+    if (!scan.valid[ind])
+        return false;
 
-void SampleSet::clear()
-{
-    for (SampleSet::iterator i = begin();
-            i != end();
-            i++)
-    {
-        delete(*i);
-    }
-    set<Sample*, CompareSample>::clear();
+    sample.index = ind;
+    sample.range = scan.range[ind];
+    sample.intensity = 0;
+    sample.x = scan.x[ind];
+    sample.y = scan.y[ind];
+
+    return true;
 }
 
-void SampleSet::appendToCloud(sensor_msgs::PointCloud& cloud, int r, int g, int b)
+void SampleSet::appendToCloud(sensor_msgs::PointCloud& cloud, int r, int g, int b) const
 {
     float color_val = 0;
 
@@ -80,8 +66,8 @@ void SampleSet::appendToCloud(sensor_msgs::PointCloud& cloud, int r, int g, int
             sample_iter++)
     {
         geometry_msgs::Point32 point;
-        point.x = (*sample_iter)->x;
-        point.y = (*sample_iter)->y;
+        point.x = sample_iter->x;
+        point.y = sample_iter->y;
         point.z = 0;
 
         cloud.points.push_back(point);
@@ -91,7 +77,7 @@ void SampleSet::appendToCloud(sensor_msgs::PointCloud& cloud, int r, int g, int
     }
 }
 
-tf::Point SampleSet::center()
+tf::Point SampleSet::center() const
 {
     float x_mean = 0.0;
     float y_mean = 0.0;
@@ -100,194 +86,238 @@ tf::Point SampleSet::center()
             i++)
 
     {
-        x_mean += ((*i)->x) / size();
-        y_mean += ((*i)->y) / size();
+        x_mean += (i->x) / size();
+        y_mean += (i->y) / size();
     }
 
     return tf::Point(x_mean, y_mean, 0.0);
 }
 
 
-void ScanMask::addScan(sensor_msgs::LaserScan& scan)
+void ScanMask::setLearningParameters(float decay, uint32_t min_scans)
 {
-    if (!filled)
-    {
-        angle_min = scan.angle_min;
-        angle_max = scan.angle_max;
-        size      = scan.ranges.size();
-        filled    = true;
-    }
-    else if (angle_min != scan.angle_min     ||
-             angle_max != scan.angle_max     ||
-             size      != scan.ranges.size())
+    decay_ = decay;
+    min_scans_ = min_scans;
+}
+
+void ScanMask::addScan(const sensor_msgs::LaserScan& scan, const CartesianScan& cartesian,
+                       const vector<BeamWindow>& excluded)
+{
+    if (background_.size() != scan.ranges.size() ||
+        angle_min_         != scan.angle_min     ||
+        angle_increment_   != scan.angle_increment)
     {
-        throw std::runtime_error("laser_scan::ScanMask::addScan: inconsistantly sized scans added to mask");
+        angle_min_ = scan.angle_min;
+        angle_increment_ = scan.angle_increment;
+        background_.assign(scan.ranges.size(), numeric_limits<float>::infinity());
+        num_scans_ = 0;
     }
 
-    for (uint32_t i = 0; i < scan.ranges.size(); i++)
-    {
-        Sample* s = Sample::Extract(i, scan);
+    const float* range = cartesian.range.data();
+    const uint8_t* valid = cartesian.valid.data();
+    float* background = background_.data();
+    size_t next_excluded = 0;
 
-        if (s != NULL)
+    for (uint32_t i = 0; i < background_.size(); i++)
+    {
+        while (next_excluded < excluded.size() && excluded[next_excluded].second <= i)
+            next_excluded++;
+        if (next_excluded < excluded.size() && excluded[next_excluded].first <= i)
         {
-            SampleSet::iterator m = mask_.find(s);
-
-            if (m != mask_.end())
-            {
-                if ((*m)->range > s->range)
-                {
-                    delete(*m);
-                    mask_.erase(m);
-                    mask_.insert(s);
-                }
-                else
-                {
-                    delete s;
-                }
-            }
-            else
-            {
-                mask_.insert(s);
-            }
+            i = excluded[next_excluded].second - 1;
+            continue;
         }
+
+        // beams without a return see no background closer than the maximum range
+        float r;
+        if (valid[i])
+            r = range[i];
+        else if (range[i] >= scan.range_max)
+            r = scan.range_max;
+        else
+            continue;
+
+        if (background[i] == numeric_limits<float>::infinity())
+            background[i] = r;
+        else
+            background[i] += decay_ * (r - background[i]);
     }
+
+    num_scans_++;
 }
 
 
-bool ScanMask::hasSample(Sample* s, float thresh)
+
+void ScanProcessor::setScan(const sensor_msgs::LaserScan& scan, const CartesianScan& cartesian, const ScanMask& mask_,
+                            float mask_threshold)
 {
-    if (s != NULL)
-    {
-        SampleSet::iterator m = mask_.find(s);
-        if (m != mask_.end())
-            if (((*m)->range - thresh) < s->range)
-                return true;
-    }
-    return false;
-}
+    angle_increment_ = scan.angle_increment;
 
+    samples_.clear();
+    clusters_.clear();
 
+    addBeams(0, scan.ranges.size(), cartesian, mask_, mask_threshold);
 
-ScanProcessor::ScanProcessor(const sensor_msgs::LaserScan& scan, ScanMask& mask_, float mask_threshold)
+    clusters_.push_back(SampleSet(samples_.data(), samples_.data() + samples_.size()));
+}
+
+void ScanProcessor::setScan(const sensor_msgs::LaserScan& scan, const CartesianScan& cartesian, const ScanMask& mask_,
+                            const vector<BeamWindow>& windows, float mask_threshold)
 {
-    scan_ = scan;
+    angle_increment_ = scan.angle_increment;
 
-    SampleSet* cluster = new SampleSet;
+    samples_.clear();
+    clusters_.clear();
 
-    for (uint32_t i = 0; i < scan.ranges.size(); i++)
-    {
-        Sample* s = Sample::Extract(i, scan);
+    for (size_t w = 0; w < windows.size(); w++)
+        addBeams(windows[w].first, min<uint32_t>(windows[w].second, scan.ranges.size()), cartesian, mask_,
+                 mask_threshold);
 
-        if (s != NULL)
-        {
-            if (!mask_.hasSample(s, mask_threshold))
-            {
-                cluster->insert(s);
-            }
-            else
-            {
-                delete s;
-            }
-        }
-    }
+    clusters_.push_back(SampleSet(samples_.data(), samples_.data() + samples_.size()));
+}
 
-    clusters_.push_back(cluster);
+void ScanProcessor::addBeams(uint32_t begin, uint32_t end, const CartesianScan& cartesian, const ScanMask& mask_,
+                             float mask_threshold)
+{
+    bool use_mask = mask_.isActive();
+
+    Sample s;
+    for (uint32_t i = begin; i < end; i++)
+    {
+        if (use_mask && mask_.hasBeam(i, cartesian.range[i], mask_threshold))
+            continue;
 
+        if (Sample::Extract(i, cartesian, s))
+            samples_.push_back(s);
+    }
 }
 
-ScanProcessor::~ScanProcessor()
+void laser_processor::mergeBeamWindows(vector<BeamWindow>& windows)
 {
-    for (list<SampleSet*>::iterator c = clusters_.begin();
-            c != clusters_.end();
-            c++)
-        delete(*c);
+    sort(windows.begin(), windows.end());
+
+    size_t num_merged = 0;
+    for (size_t w = 0; w < windows.size(); w++)
+    {
+        if (windows[w].first >= windows[w].second)
+            continue;
+
+        if (num_merged > 0 && windows[w].first <= windows[num_merged - 1].second)
+            windows[num_merged - 1].second = max(windows[num_merged - 1].second, windows[w].second);
+        else
+            windows[num_merged++] = windows[w];
+    }
+    windows.resize(num_merged);
 }
 
 void
 ScanProcessor::removeLessThan(uint32_t num)
 {
-    list<SampleSet*>::iterator c_iter = clusters_.begin();
-    while (c_iter != clusters_.end())
+    vector<SampleSet>::iterator last = clusters_.begin();
+    for (vector<SampleSet>::iterator c_iter = clusters_.begin(); c_iter != clusters_.end(); ++c_iter)
     {
-        if ((*c_iter)->size() < num)
-        {
-            delete(*c_iter);
-            clusters_.erase(c_iter++);
-        }
-        else
-        {
-            ++c_iter;
-        }
+        if (c_iter->size() >= num)
+            *(last++) = *c_iter;
     }
+    clusters_.erase(last, clusters_.end());
 }
 
 
 void
 ScanProcessor::splitConnected(float thresh)
 {
-    list<SampleSet*> tmp_clusters;
+    const float thresh_sq = thresh * thresh;
 
-    list<SampleSet*>::iterator c_iter = clusters_.begin();
+    clustered_samples_.clear();
+    cluster_ends_.clear();
 
     // For each cluster
-    while (c_iter != clusters_.end())
+    for (vector<SampleSet>::iterator c_iter = clusters_.begin(); c_iter != clusters_.end(); ++c_iter)
     {
-        // Go through the entire list
-        while ((*c_iter)->size() > 0)
+        const Sample* cluster = c_iter->begin();
+        const int num_samples = c_iter->size();
+
+        // The samples not yet assigned to a cluster form a doubly linked list in index order,
+        // num_samples is the sentinel whose successor is the first remaining sample
+        next_remaining_.resize(num_samples + 1);
+        prev_remaining_.resize(num_samples + 1);
+        for (int i = 0; i <= num_samples; ++i)
         {
-            // Take the first element
-            SampleSet::iterator s_first = (*c_iter)->begin();
-
-            // Start a new queue
-            list<Sample*> sample_queue;
-            sample_queue.push_back(*s_first);
+            next_remaining_[i] = i + 1;
+            prev_remaining_[i] = i - 1;
+        }
+        next_remaining_[num_samples] = (num_samples > 0) ? 0 : num_samples;
+        prev_remaining_[0] = num_samples;
+        prev_remaining_[num_samples] = num_samples - 1;
 
-            (*c_iter)->erase(s_first);
+        labels_.resize(num_samples);
+        int num_labels = 0;
 
-            // Grow until we get to the end of the queue
-            list<Sample*>::iterator s_q = sample_queue.begin();
-            while (s_q != sample_queue.end())
+        // Go through the entire list
+        while (next_remaining_[num_samples] != num_samples)
+        {
+            // Take the first remaining sample and start a new cluster
+            int label = num_labels++;
+            int q = next_remaining_[num_samples];
+            unlinkRemaining(q);
+
+            // Every sample adds at most the first connected remaining sample inside its look-ahead
+            // window, so the cluster grows as a chain until no further sample is found
+            while (q >= 0)
             {
-                int expand = (int)(asin(thresh / (*s_q)->range) / scan_.angle_increment);
+                labels_[q] = label;
 
-                SampleSet::iterator s_rest = (*c_iter)->begin();
+                const Sample& s_q = cluster[q];
+                int expand = (int)(asin(thresh / s_q.range) / angle_increment_);
+                int next_q = -1;
 
-                while ((s_rest != (*c_iter)->end() &&
-                        (*s_rest)->index < (*s_q)->index + expand))
+                for (int r = next_remaining_[num_samples];
+                        r != num_samples && cluster[r].index < s_q.index + expand;
+                        r = next_remaining_[r])
                 {
-                    if ((*s_rest)->range - (*s_q)->range > thresh)
-                    {
+                    const Sample& rest = cluster[r];
+                    if (rest.range - s_q.range > thresh)
                         break;
-                    }
-                    else if (sqrt(pow((*s_q)->x - (*s_rest)->x, 2.0f) + pow((*s_q)->y - (*s_rest)->y, 2.0f)) < thresh)
+
+                    float dx = s_q.x - rest.x;
+                    float dy = s_q.y - rest.y;
+                    if (dx * dx + dy * dy < thresh_sq)
                     {
-                        sample_queue.push_back(*s_rest);
-                        (*c_iter)->erase(s_rest++);
+                        unlinkRemaining(r);
+                        next_q = r;
                         break;
                     }
-                    else
-                    {
-                        ++s_rest;
-                    }
                 }
-                s_q++;
+
+                q = next_q;
             }
+        }
 
-            // Move all the samples into the new cluster
-            SampleSet* c = new SampleSet;
-            for (s_q = sample_queue.begin(); s_q != sample_queue.end(); s_q++)
-                c->insert(*s_q);
+        // Move all the samples into their clusters, which keeps them ordered by index
+        cluster_offsets_.assign(num_labels + 1, 0);
+        for (int i = 0; i < num_samples; ++i)
+            ++cluster_offsets_[labels_[i] + 1];
 
-            // Store the temporary clusters
-            tmp_clusters.push_back(c);
+        size_t cluster_begin = clustered_samples_.size();
+        for (int l = 0; l < num_labels; ++l)
+        {
+            cluster_offsets_[l + 1] += cluster_offsets_[l];
+            cluster_ends_.push_back(cluster_begin + cluster_offsets_[l + 1]);
         }
 
-        //Now that c_iter is empty, we can delete
-        delete(*c_iter);
-
-        //And remove from the map
-        clusters_.erase(c_iter++);
+        clustered_samples_.resize(cluster_begin + num_samples);
+        for (int i = 0; i < num_samples; ++i)
+            clustered_samples_[cluster_begin + cluster_offsets_[labels_[i]]++] = cluster[i];
     }
 
-    clusters_.insert(clusters_.begin(), tmp_clusters.begin(), tmp_clusters.end());
+    // The clusters are now grouped in clustered_samples_, swapping keeps the buffers of both vectors
+    samples_.swap(clustered_samples_);
+
+    clusters_.clear();
+    size_t cluster_begin = 0;
+    for (size_t i = 0; i < cluster_ends_.size(); ++i)
+    {
+        clusters_.push_back(SampleSet(samples_.data() + cluster_begin, samples_.data() + cluster_ends_[i]));
+        cluster_begin = cluster_ends_[i];
+    }
 }
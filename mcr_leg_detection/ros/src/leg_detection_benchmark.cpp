@@ -0,0 +1,347 @@
+/*
+ * Copyright 2018 Bonn-Rhein-Sieg University
+ *
+ * Replays recorded laser scans through the leg detection pipeline without a ROS master and
+ * reports the latency of every stage, so that changes of the algorithms can be compared on
+ * the same data.
+ *
+ * Usage: leg_detection_benchmark <trained_forest.yaml> <scans> [options]
+ *   --pose x y yaw        fixed pose of the scanner in the fixed frame (default 0 0 0)
+ *   --repeat n            replay the scans n times, every time with a new detector (default 1)
+ *   --roi                 enable the track-focused ROI mode
+ *   --background          enable the background learning
+ *   --write-binary file   write the scans in the binary format and exit
+ *
+ * The scans are either the CSV output of "rostopic echo -p /scan > scans.csv" or the binary
+ * format: the magic "LEGSCAN1", followed by one record per scan of
+ *   double stamp, float angle_min, float angle_increment, float range_min, float range_max,
+ *   uint32 num_ranges, float ranges[num_ranges]
+ * in the byte order of the machine.
+ *
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/ml/ml.hpp>
+
+#include "mcr_leg_detection/flat_forest.h"
+#include "mcr_leg_detection/leg_detector.h"
+
+using namespace std;
+
+namespace
+{
+const char BINARY_MAGIC[8] = { 'L', 'E', 'G', 'S', 'C', 'A', 'N', '1' };
+
+/** Finds the column of every field in the header of a "rostopic echo -p" CSV file */
+bool readCsvHeader(const string& line, vector<string>& names)
+{
+    names.clear();
+    stringstream stream(line);
+    string name;
+    while (getline(stream, name, ','))
+        names.push_back(name);
+
+    return !names.empty() && names[0] == "%time";
+}
+
+bool readCsv(ifstream& in, vector<sensor_msgs::LaserScan>& scans)
+{
+    string line;
+    vector<string> names;
+    if (!getline(in, line) || !readCsvHeader(line, names))
+        return false;
+
+    int stamp_col = -1, angle_min_col = -1, angle_increment_col = -1;
+    int range_min_col = -1, range_max_col = -1, first_range_col = -1, num_ranges = 0;
+    for (size_t c = 0; c < names.size(); c++)
+    {
+        const string& name = names[c];
+        if (name == "field.header.stamp")
+            stamp_col = c;
+        else if (name == "field.angle_min")
+            angle_min_col = c;
+        else if (name == "field.angle_increment")
+            angle_increment_col = c;
+        else if (name == "field.range_min")
+            range_min_col = c;
+        else if (name == "field.range_max")
+            range_max_col = c;
+        else if (name.compare(0, 12, "field.ranges") == 0)
+        {
+            if (first_range_col < 0)
+                first_range_col = c;
+            num_ranges++;
+        }
+    }
+
+    if (stamp_col < 0 || angle_min_col < 0 || angle_increment_col < 0 || range_min_col < 0 ||
+        range_max_col < 0 || first_range_col < 0)
+        return false;
+
+    vector<string> fields;
+    while (getline(in, line))
+    {
+        fields.clear();
+        stringstream stream(line);
+        string field;
+        while (getline(stream, field, ','))
+            fields.push_back(field);
+
+        if (fields.size() < static_cast<size_t>(first_range_col + num_ranges))
+            continue;
+
+        sensor_msgs::LaserScan scan;
+        scan.header.frame_id = "laser";
+        // the stamp is written in nanoseconds
+        scan.header.stamp.fromNSec(strtoull(fields[stamp_col].c_str(), NULL, 10));
+        scan.angle_min = atof(fields[angle_min_col].c_str());
+        scan.angle_increment = atof(fields[angle_increment_col].c_str());
+        scan.angle_max = scan.angle_min + (num_ranges - 1) * scan.angle_increment;
+        scan.range_min = atof(fields[range_min_col].c_str());
+        scan.range_max = atof(fields[range_max_col].c_str());
+
+        scan.ranges.resize(num_ranges);
+        for (int r = 0; r < num_ranges; r++)
+            scan.ranges[r] = atof(fields[first_range_col + r].c_str());
+
+        scans.push_back(scan);
+    }
+
+    return true;
+}
+
+bool readBinary(ifstream& in, vector<sensor_msgs::LaserScan>& scans)
+{
+    while (in.peek() != EOF)
+    {
+        double stamp;
+        float header[4];
+        uint32_t num_ranges;
+        in.read(reinterpret_cast<char*>(&stamp), sizeof(stamp));
+        in.read(reinterpret_cast<char*>(header), sizeof(header));
+        in.read(reinterpret_cast<char*>(&num_ranges), sizeof(num_ranges));
+        if (!in)
+            return false;
+
+        sensor_msgs::LaserScan scan;
+        scan.header.frame_id = "laser";
+        scan.header.stamp.fromSec(stamp);
+        scan.angle_min = header[0];
+        scan.angle_increment = header[1];
+        scan.angle_max = scan.angle_min + (static_cast<float>(num_ranges) - 1) * scan.angle_increment;
+        scan.range_min = header[2];
+        scan.range_max = header[3];
+
+        scan.ranges.resize(num_ranges);
+        if (num_ranges > 0)
+            in.read(reinterpret_cast<char*>(&scan.ranges[0]), num_ranges * sizeof(float));
+        if (!in)
+            return false;
+
+        scans.push_back(scan);
+    }
+
+    return true;
+}
+
+bool readScans(const char* file_name, vector<sensor_msgs::LaserScan>& scans)
+{
+    ifstream in(file_name, ios::binary);
+    if (!in)
+        return false;
+
+    char magic[sizeof(BINARY_MAGIC)];
+    in.read(magic, sizeof(magic));
+    if (in && memcmp(magic, BINARY_MAGIC, sizeof(magic)) == 0)
+        return readBinary(in, scans);
+
+    in.clear();
+    in.seekg(0);
+    return readCsv(in, scans);
+}
+
+bool writeBinary(const char* file_name, const vector<sensor_msgs::LaserScan>& scans)
+{
+    ofstream out(file_name, ios::binary);
+    out.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+
+    for (size_t s = 0; s < scans.size(); s++)
+    {
+        const sensor_msgs::LaserScan& scan = scans[s];
+        double stamp = scan.header.stamp.toSec();
+        float header[4] = { scan.angle_min, scan.angle_increment, scan.range_min, scan.range_max };
+        uint32_t num_ranges = scan.ranges.size();
+
+        out.write(reinterpret_cast<const char*>(&stamp), sizeof(stamp));
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(&num_ranges), sizeof(num_ranges));
+        if (num_ranges > 0)
+            out.write(reinterpret_cast<const char*>(&scan.ranges[0]), num_ranges * sizeof(float));
+    }
+
+    return static_cast<bool>(out);
+}
+
+//! The value below which the given fraction of the sorted values lies (nearest rank)
+double percentile(const vector<double>& sorted, double fraction)
+{
+    if (sorted.empty())
+        return 0.0;
+
+    size_t rank = static_cast<size_t>(ceil(fraction * sorted.size()));
+    return sorted[min(sorted.size(), max<size_t>(rank, 1)) - 1];
+}
+
+void printStage(const char* name, vector<double>& seconds)
+{
+    sort(seconds.begin(), seconds.end());
+
+    double sum = 0.0;
+    for (size_t i = 0; i < seconds.size(); i++)
+        sum += seconds[i];
+    double mean = seconds.empty() ? 0.0 : sum / seconds.size();
+
+    printf("%-16s %10.1f %10.1f %10.1f %10.1f %10.1f\n", name, 1e6 * mean, 1e6 * percentile(seconds, 0.5),
+           1e6 * percentile(seconds, 0.9), 1e6 * percentile(seconds, 0.99), 1e6 * (seconds.empty() ? 0.0 : seconds.back()));
+}
+
+void printUsage(const char* program)
+{
+    printf("Usage: %s <trained_forest.yaml> <scans> [--pose x y yaw] [--repeat n] [--roi] [--background] "
+           "[--write-binary file]\n", program);
+}
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    double pose_x = 0.0, pose_y = 0.0, pose_yaw = 0.0;
+    int repetitions = 1;
+    const char* binary_file = NULL;
+    LegDetector::Parameters params;
+
+    for (int a = 3; a < argc; a++)
+    {
+        string option = argv[a];
+        if (option == "--pose" && a + 3 < argc)
+        {
+            pose_x = atof(argv[++a]);
+            pose_y = atof(argv[++a]);
+            pose_yaw = atof(argv[++a]);
+        }
+        else if (option == "--repeat" && a + 1 < argc)
+            repetitions = max(1, atoi(argv[++a]));
+        else if (option == "--roi")
+            params.roi_enabled = true;
+        else if (option == "--background")
+            params.background_learning_enabled = true;
+        else if (option == "--write-binary" && a + 1 < argc)
+            binary_file = argv[++a];
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    vector<sensor_msgs::LaserScan> scans;
+    if (!readScans(argv[2], scans) || scans.empty())
+    {
+        printf("Could not read any scans from %s\n", argv[2]);
+        return 1;
+    }
+
+    if (binary_file)
+    {
+        if (!writeBinary(binary_file, scans))
+        {
+            printf("Could not write %s\n", binary_file);
+            return 1;
+        }
+        printf("Wrote %zu scans to %s\n", scans.size(), binary_file);
+        return 0;
+    }
+
+    cv::Ptr<cv::ml::RTrees> trained_forest = cv::Algorithm::load<cv::ml::RTrees>(argv[1]);
+    FlatForest forest;
+    if (trained_forest.empty() || !forest.load(*trained_forest))
+    {
+        printf("Could not load a random forests classifier from %s\n", argv[1]);
+        return 1;
+    }
+
+    // the robot stands still at the given pose
+    tf::Transform scan_to_fixed(tf::createQuaternionFromYaw(pose_yaw), tf::Vector3(pose_x, pose_y, 0.0));
+
+    size_t num_scans = scans.size() * repetitions;
+    vector<double> segmentation, features, classification, tracking, total;
+    segmentation.reserve(num_scans);
+    features.reserve(num_scans);
+    classification.reserve(num_scans);
+    tracking.reserve(num_scans);
+    total.reserve(num_scans);
+
+    double num_clusters = 0.0, num_candidates = 0.0, num_tracks = 0.0, num_full_scans = 0.0;
+
+    for (int r = 0; r < repetitions; r++)
+    {
+        LegDetector detector("fixed");
+        detector.setParameters(params);
+        if (!detector.setForest(forest))
+        {
+            printf("The forest does not classify the %d leg features\n", LEG_FEATURE_COUNT);
+            return 1;
+        }
+
+        for (size_t s = 0; s < scans.size(); s++)
+        {
+            detector.processScan(scans[s], &scan_to_fixed, s > 0);
+
+            const LegDetectorTimings& t = detector.getTimings();
+            segmentation.push_back(t.segmentation);
+            features.push_back(t.features);
+            classification.push_back(t.classification);
+            tracking.push_back(t.tracking);
+            total.push_back(t.segmentation + t.features + t.classification + t.tracking);
+
+            num_clusters += detector.getNumClusters();
+            num_candidates += detector.getNumCandidates();
+            num_tracks += detector.getTracks().size();
+            num_full_scans += detector.wasFullScan() ? 1.0 : 0.0;
+        }
+    }
+
+    double total_seconds = 0.0;
+    for (size_t i = 0; i < total.size(); i++)
+        total_seconds += total[i];
+
+    printf("%zu scans (%zu x %d), %.1f scans/s\n", num_scans, scans.size(), repetitions,
+           total_seconds > 0.0 ? num_scans / total_seconds : 0.0);
+    printf("per scan: %.2f clusters, %.2f leg candidates, %.2f tracks, %.1f%% full scans\n\n",
+           num_clusters / num_scans, num_candidates / num_scans, num_tracks / num_scans,
+           100.0 * num_full_scans / num_scans);
+
+    printf("%-16s %10s %10s %10s %10s %10s\n", "stage [us]", "mean", "p50", "p90", "p99", "max");
+    printStage("segmentation", segmentation);
+    printStage("features", features);
+    printStage("classification", classification);
+    printStage("tracking", tracking);
+    printStage("total", total);
+
+    return 0;
+}
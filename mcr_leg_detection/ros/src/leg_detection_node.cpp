@@ -33,18 +33,23 @@
  *********************************************************************/
 
 #include <algorithm>
+#include <atomic>
 #include <dynamic_reconfigure/server.h>
+#include <Eigen/StdVector>
 #include <math.h>
 #include <message_filters/subscriber.h>
 #include <opencv/cxcore.h>
 #include <opencv/cv.h>
 #include <opencv/ml.h>
+#include <ros/callback_queue.h>
 #include <ros/ros.h>
 #include <sensor_msgs/LaserScan.h>
 #include <std_srvs/Empty.h>
 #include <tf/message_filter.h>
 #include <tf/transform_datatypes.h>
 #include <visualization_msgs/MarkerArray.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <mcr_perception_msgs/PersonList.h>
 #include <mcr_perception_msgs/Person.h>
@@ -53,12 +58,17 @@
 
 #include "mcr_leg_detection/PositionMeasurement.h"
 #include "mcr_leg_detection/LegDetectionConfig.h"
-#include "mcr_leg_detection/laser_processor.h"
 #include "mcr_leg_detection/calc_leg_features.h"
-#include "mcr_leg_detection/tracker_kalman.h"
+#include "mcr_leg_detection/flat_forest.h"
+#include "mcr_leg_detection/leg_detector.h"
 #include "mcr_leg_detection/state_pos_vel.h"
 #include "mcr_leg_detection/rgb.h"
 
+// a forest generated by leg_forest_codegen, used when no model file is given
+#ifdef LEG_DETECTION_COMPILED_FOREST
+#include LEG_DETECTION_COMPILED_FOREST
+#endif
+
 
 using namespace std;
 using namespace laser_processor;
@@ -66,16 +76,17 @@ using namespace ros;
 using namespace tf;
 using namespace estimation;
 using namespace BFL;
-using namespace MatrixWrapper;
 
-bool is_detection_enabled = false;
+// set by the start and stop services, read by the scan callbacks of the spinner threads
+std::atomic<bool> is_detection_enabled(false);
 
-static const double no_observation_timeout_s = 0.5;
 static const double max_second_leg_age_s = 2.0;
-static const double max_track_jump_m = 1.0;
 static const double max_meas_jump_m = 0.75;  // 1.0
 static const double leg_pair_separation_m = 1.0;
 static const string fixed_frame = "/base_link";
+// the scanner counts as stationary for the background learning below these velocities
+static const double max_stationary_velocity_mps = 0.02;
+static const double max_stationary_rotation_radps = 0.02;
 
 bool start(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res)
 {
@@ -91,129 +102,52 @@ bool stop(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res)
     return true;
 }
 
-class SavedFeature
-{
-public:
-    static int nextid;
-    TransformListener& tfl_;
-
-    BFL::StatePosVel sys_sigma_;
-    TrackerKalman filter_;
-
-    string id_;
-    string object_id;
-    ros::Time time_;
-    ros::Time meas_time_;
-
-    Stamped<Point> position_;
-    float dist_to_person_;
-
-    // one leg tracker
-    SavedFeature(Stamped<Point> loc, TransformListener& tfl)
-        : tfl_(tfl),
-          sys_sigma_(Vector3(0.05, 0.05, 0.05), Vector3(1.0, 1.0, 1.0)),
-          filter_("tracker_name", sys_sigma_)
-    {
-        char id[100];
-        snprintf(id, 100, "legtrack%d", nextid++);
-        id_ = std::string(id);
-
-        object_id = "";
-        time_ = loc.stamp_;
-        meas_time_ = loc.stamp_;
-	
-        try
-        {
-            tfl_.transformPoint(fixed_frame, loc, loc);
-        }
-        catch (...)
-        {
-            ROS_WARN("TF exception spot 6.");
-        }
-        StampedTransform pose(tf::Transform(Quaternion(0.0, 0.0, 0.0, 1.0), loc), loc.stamp_, id_, loc.frame_id_);
-        tfl_.setTransform(pose);
-
-        StatePosVel prior_sigma(Vector3(0.1, 0.1, 0.1), Vector3(0.0000001, 0.0000001, 0.0000001));
-        filter_.initialize(loc, prior_sigma, time_.toSec());
-
-        StatePosVel est;
-        filter_.getEstimate(est);
-
-        updatePosition();
-    }
-
-    void propagate(ros::Time time)
-    {
-        time_ = time;
-
-        filter_.updatePrediction(time.toSec());
-
-        updatePosition();
-    }
-
-    void update(Stamped<Point> loc)
-    {
-        StampedTransform pose(tf::Transform(Quaternion(0.0, 0.0, 0.0, 1.0), loc), loc.stamp_, id_, loc.frame_id_);
-        tfl_.setTransform(pose);
-
-        meas_time_ = loc.stamp_;
-        time_ = meas_time_;
-
-        SymmetricMatrix cov(3);
-        cov = 0.0;
-        cov(1, 1) = 0.0025;
-        cov(2, 2) = 0.0025;
-        cov(3, 3) = 0.0025;
+int g_argc;
+char** g_argv;
 
-        filter_.updateCorrection(loc, cov);
+/**
+ * A laser scanner of the leg detection. Its scans are processed up to the leg candidates by its own
+ * thread, which serves the callback queue of the subscription.
+ */
+struct ScanSource
+{
+    std::string topic_;
+    ros::CallbackQueue queue_;
+    ros::NodeHandle nh_;
+    message_filters::Subscriber<sensor_msgs::LaserScan> laser_sub_;
+    boost::shared_ptr<tf::MessageFilter<sensor_msgs::LaserScan> > laser_notifier_;
+    boost::shared_ptr<ros::AsyncSpinner> spinner_;
 
-        updatePosition();
-    }
+    LegCandidateDetector detector_;
+    tf::StampedTransform last_scanner_pose_;
+    bool has_last_scanner_pose_;
 
-    double getLifetime()
-    {
-        return filter_.getLifetime();
-    }
+    //! stamp of the latest scan which reached the fusion, guarded by LegDetection::fusion_mutex_
+    ros::Time latest_stamp_;
 
-private:
-    void updatePosition()
+    ScanSource(const ros::NodeHandle& nh, const std::string& topic, tf::TransformListener& tfl)
+        : topic_(topic),
+          nh_(nh),
+          detector_(fixed_frame),
+          has_last_scanner_pose_(false)
     {
-        StatePosVel est;
-        filter_.getEstimate(est);
-
-        position_[0] = est.pos_[0];
-        position_[1] = est.pos_[1];
-        position_[2] = est.pos_[2];
-        position_.stamp_ = time_;
-        position_.frame_id_ = fixed_frame;
+        nh_.setCallbackQueue(&queue_);
+        laser_sub_.subscribe(nh_, topic, 10);
+        laser_notifier_.reset(new tf::MessageFilter<sensor_msgs::LaserScan>(laser_sub_, tfl, fixed_frame, 10, nh_));
+        laser_notifier_->setTolerance(ros::Duration(0.01));
+        spinner_.reset(new ros::AsyncSpinner(1, &queue_));
     }
 };
 
-int SavedFeature::nextid = 0;
-
-class MatchedFeature
+/** The leg candidates of one scan, waiting for the fusion */
+struct CandidateBatch
 {
-public:
-    SampleSet* candidate_;
-    SavedFeature* closest_;
-    float distance_;
-
-    MatchedFeature(SampleSet* candidate, SavedFeature* closest, float distance)
-        : candidate_(candidate),
-          closest_(closest),
-          distance_(distance)
-    {
-    }
-
-    inline bool operator<(const MatchedFeature& b) const
-    {
-        return (distance_ < b.distance_);
-    }
+    ros::Time stamp_;
+    size_t source_;
+    std::vector<tf::Stamped<tf::Point> > candidates_;
+    bool full_scan_;
 };
 
-int g_argc;
-char** g_argv;
-
 // actual leg detector node
 class LegDetection
 {
@@ -221,13 +155,7 @@ public:
     NodeHandle nh_;
 
     TransformListener tfl_;
-    ScanMask mask_;
-    int mask_count_;
-    cv::Ptr<cv::ml::RTrees> forest;
-    float connected_thresh_;
-    int feat_count_;
     char save_[100];
-    list<SavedFeature*> saved_features_;
     boost::mutex saved_mutex_;
     int feature_id_;
 
@@ -235,31 +163,72 @@ public:
     ros::Publisher pub_legs_;
     ros::Publisher pub_visualization_marker_;
 
-    message_filters::Subscriber<sensor_msgs::LaserScan> laser_sub_;
-    tf::MessageFilter<sensor_msgs::LaserScan> laser_notifier_;
+    // the candidates of all scanners update the same tracks, one batch after the other in the
+    // order of their time stamps
+    boost::mutex fusion_mutex_;
+    LegTracker tracker_;
+    std::vector<CandidateBatch> pending_batches_;
+    ros::Time last_fused_stamp_;
+    // a batch waits at most this long (in scan time) for the scans of the other scanners
+    double sync_tolerance_s_;
+
+    std::vector<boost::shared_ptr<ScanSource> > sources_;
 
     dynamic_reconfigure::Server<mcr_leg_detection::LegDetectionConfig> dynamic_reconfig_server_;
+    boost::mutex config_mutex_;
     mcr_leg_detection::LegDetectionConfig dyn_recfg_config_;
+    LegDetectorParameters detector_params_;
 
     LegDetection(ros::NodeHandle nh)
-        : nh_(nh),
-          mask_count_(0),
-          connected_thresh_(0.06),
-          feat_count_(0),
-          laser_sub_(nh_, "scan", 10),
-          laser_notifier_(laser_sub_, tfl_, fixed_frame, 10)
+        : nh_(nh)
     {
-        forest = cv::ml::RTrees::create();
-	
+        FlatForest forest;
         if (g_argc > 1)
         {
-            forest->load(g_argv[1]);
-            feat_count_ = forest->getActiveVarCount();
-            printf("Loaded forest with %d features: %s\n", feat_count_, g_argv[1]);
+            cv::Ptr<cv::ml::RTrees> trained_forest = cv::Algorithm::load<cv::ml::RTrees>(g_argv[1]);
+            if (!trained_forest.empty() && forest.load(*trained_forest))
+                printf("Loaded forest with %d features: %s\n", forest.getVarCount(), g_argv[1]);
+            else
+                printf("Could not load a random forests classifier from %s\n", g_argv[1]);
         }
         else
         {
+#ifdef LEG_DETECTION_COMPILED_FOREST
+            forest.assign(compiled_leg_forest::nodes, sizeof(compiled_leg_forest::nodes) / sizeof(FlatForest::Node),
+                          compiled_leg_forest::roots, sizeof(compiled_leg_forest::roots) / sizeof(int32_t),
+                          compiled_leg_forest::class_labels, sizeof(compiled_leg_forest::class_labels) / sizeof(float));
+            printf("Using the compiled forest with %d features\n", forest.getVarCount());
+#else
             printf("Please provide a trained random forests classifier as an input.\n");
+#endif
+        }
+
+        // every scanner has its own detector, all of them use the same forest
+        std::vector<std::string> scan_topics;
+        if (!nh_.getParam("scan_topics", scan_topics) || scan_topics.empty())
+            scan_topics.push_back("scan");
+        nh_.param("scan_sync_tolerance", sync_tolerance_s_, 0.1);
+
+        for (size_t s = 0; s < scan_topics.size(); s++)
+            sources_.push_back(boost::shared_ptr<ScanSource>(new ScanSource(nh_, scan_topics[s], tfl_)));
+
+        bool forest_ok = true;
+        for (size_t s = 0; s < sources_.size(); s++)
+            forest_ok = sources_[s]->detector_.setForest(forest) && forest_ok;
+
+        if (forest_ok)
+        {
+            int num_used = 0;
+            for (int f = 0; f < LEG_FEATURE_COUNT; f++)
+            {
+                if (sources_[0]->detector_.getFeatureMask() & (1u << f))
+                    num_used++;
+            }
+            printf("The forest uses %d of the %d leg features\n", num_used, LEG_FEATURE_COUNT);
+        }
+        else
+        {
+            printf("The forest does not classify the %d leg features.\n", LEG_FEATURE_COUNT);
             shutdown();
         }
 
@@ -267,12 +236,23 @@ public:
         pub_legs_ = nh_.advertise < mcr_perception_msgs::PersonList > ("leg_positions", 1);
         pub_visualization_marker_ = nh.advertise<visualization_msgs::MarkerArray>("/visualization_marker_array", 1);
 
-        laser_notifier_.registerCallback(boost::bind(&LegDetection::laserCallback, this, _1));
-        laser_notifier_.setTolerance(ros::Duration(0.01));
-
         dynamic_reconfig_server_.setCallback(boost::bind(&LegDetection::dynamic_reconfig_callback, this, _1, _2));
 
         feature_id_ = 0;
+
+        for (size_t s = 0; s < sources_.size(); s++)
+        {
+            sources_[s]->laser_notifier_->registerCallback(boost::bind(&LegDetection::laserCallback, this, _1, s));
+            sources_[s]->spinner_->start();
+            ROS_INFO("Detecting legs in %s", sources_[s]->laser_sub_.getTopic().c_str());
+        }
+    }
+
+    ~LegDetection()
+    {
+        // the scan threads use the members of the node
+        for (size_t s = 0; s < sources_.size(); s++)
+            sources_[s]->spinner_->stop();
     }
 
     void publishVisualizationMarker(const mcr_perception_msgs::PersonList &person_list)
@@ -314,171 +294,183 @@ public:
 
     void dynamic_reconfig_callback(mcr_leg_detection::LegDetectionConfig &config, uint32_t level)
     {
+        boost::mutex::scoped_lock lock(config_mutex_);
         dyn_recfg_config_ = config;
+
+        detector_params_.background_learning_enabled = config.background_learning_enabled;
+        detector_params_.background_decay = config.background_decay;
+        detector_params_.background_min_scans = config.background_min_scans;
+        detector_params_.roi_enabled = config.roi_enabled;
+        detector_params_.roi_full_scan_period = config.roi_full_scan_period;
+        detector_params_.roi_margin = config.roi_margin;
+    }
+
+    /**
+     * Checks with the pose of the scanner in the odometry frame whether the robot stood still since
+     * the last scan of the scanner. A missing transform counts as moving.
+     */
+    bool isScannerStationary(ScanSource& source, const sensor_msgs::LaserScan& scan, const std::string& odom_frame)
+    {
+        tf::StampedTransform scanner_pose;
+        try
+        {
+            tfl_.lookupTransform(odom_frame, scan.header.frame_id, scan.header.stamp, scanner_pose);
+        }
+        catch (tf::TransformException &ex)
+        {
+            ROS_WARN_THROTTLE(10.0, "Could not get the scanner pose for the background learning: %s", ex.what());
+            source.has_last_scanner_pose_ = false;
+            return false;
+        }
+
+        bool is_stationary = false;
+        if (source.has_last_scanner_pose_)
+        {
+            double dt = (scanner_pose.stamp_ - source.last_scanner_pose_.stamp_).toSec();
+            double translation = (scanner_pose.getOrigin() - source.last_scanner_pose_.getOrigin()).length();
+            double rotation = scanner_pose.getRotation().angleShortestPath(source.last_scanner_pose_.getRotation());
+
+            is_stationary = (dt > 0.0) &&
+                            (translation <= max_stationary_velocity_mps * dt) &&
+                            (rotation <= max_stationary_rotation_radps * dt);
+        }
+
+        source.last_scanner_pose_ = scanner_pose;
+        source.has_last_scanner_pose_ = true;
+
+        return is_stationary;
     }
 
-    void laserCallback(const sensor_msgs::LaserScan::ConstPtr& scan)
+    /** Runs in the thread of the scanner: detects the leg candidates and hands them to the fusion */
+    void laserCallback(const sensor_msgs::LaserScan::ConstPtr& scan, size_t source_index)
     {
         //if not enabled, no processing
         if (!is_detection_enabled) return;
 
-        ScanProcessor processor(*scan, mask_);
+        ScanSource& source = *sources_[source_index];
 
-        processor.splitConnected(connected_thresh_);
-        processor.removeLessThan(5);
+        mcr_leg_detection::LegDetectionConfig config;
+        {
+            boost::mutex::scoped_lock lock(config_mutex_);
+            config = dyn_recfg_config_;
+            source.detector_.setParameters(detector_params_);
+        }
 
-        CvMat* tmp_mat = cvCreateMat(1, feat_count_, CV_32FC1);
+        // the background is only learned while the robot stands still
+        bool scanner_stationary = false;
+        if (config.background_learning_enabled)
+            scanner_stationary = isScannerStationary(source, *scan, config.background_odom_frame);
+        else
+            source.has_last_scanner_pose_ = false;
 
-        // if no measurement matches to a tracker in the last <no_observation_timeout>  seconds: erase tracker
-        ros::Time purge = scan->header.stamp + ros::Duration().fromSec(-no_observation_timeout_s);
-        list<SavedFeature*>::iterator sf_iter = saved_features_.begin();
-        while (sf_iter != saved_features_.end())
+        // a single lookup for the whole scan. The tracks are kept in the fixed frame, so candidates
+        // without the transform cannot be fused. The scanner still counts as up to date, so the
+        // batches of the other scanners do not wait for it.
+        tf::StampedTransform scan_to_fixed;
+        try
         {
-            if ((*sf_iter)->meas_time_ < purge)
-            {
-                delete(*sf_iter);
-                saved_features_.erase(sf_iter++);
-            }
-            else ++sf_iter;
+            tfl_.lookupTransform(fixed_frame, scan->header.frame_id, scan->header.stamp, scan_to_fixed);
         }
-
-        // System update of trackers, and copy updated ones in propagate list
-        list<SavedFeature*> propagated;
-        for (list<SavedFeature*>::iterator sf_iter = saved_features_.begin(); sf_iter != saved_features_.end(); sf_iter++)
+        catch (tf::TransformException &ex)
         {
-            (*sf_iter)->propagate(scan->header.stamp);
-            propagated.push_back(*sf_iter);
+            ROS_WARN("TF exception spot 3: %s", ex.what());
+
+            boost::mutex::scoped_lock lock(fusion_mutex_);
+            if (source.latest_stamp_ < scan->header.stamp)
+                source.latest_stamp_ = scan->header.stamp;
+            fuseBatches(config);
+            return;
         }
 
-        // Detection step: build up the set of "candidate" clusters
-        list<SampleSet*> candidates;
-        for (list<SampleSet*>::iterator i = processor.getClusters().begin(); i != processor.getClusters().end(); i++)
+        // the ROI mode looks around the latest estimates of the tracks
+        std::vector<tf::Point> track_positions;
+        if (config.roi_enabled)
         {
-            vector<float> f = calcLegFeatures(*i, *scan);
+            boost::mutex::scoped_lock lock(fusion_mutex_);
+            tracker_.getPositions(track_positions);
+        }
 
-            for (int k = 0; k < feat_count_; k++)
-                tmp_mat->data.fl[k] = (float)(f[k]);
+        source.detector_.detect(*scan, &scan_to_fixed, scanner_stationary, track_positions);
 
-            if (forest->predict(cv::InputArray(*tmp_mat)) > 0)
-            {
-                candidates.push_back(*i);
-            }
+        CandidateBatch batch;
+        batch.stamp_ = scan->header.stamp;
+        batch.source_ = source_index;
+        batch.candidates_ = source.detector_.getCandidates();
+        batch.full_scan_ = source.detector_.wasFullScan();
+
+        boost::mutex::scoped_lock lock(fusion_mutex_);
+
+        // the tracks cannot be predicted backwards in time
+        if (batch.stamp_ < last_fused_stamp_)
+        {
+            ROS_WARN_THROTTLE(10.0, "Dropped a scan of %s which arrived %.3f s too late for the fusion",
+                              source.topic_.c_str(), (last_fused_stamp_ - batch.stamp_).toSec());
+            return;
         }
 
-        // For each candidate, find the closest tracker (within threshold) and add to the match list
-        // If no tracker is found, start a new one
-        multiset<MatchedFeature> matches;
-        for (list<SampleSet*>::iterator cf_iter = candidates.begin(); cf_iter != candidates.end(); cf_iter++)
+        if (source.latest_stamp_ < batch.stamp_)
+            source.latest_stamp_ = batch.stamp_;
+
+        std::vector<CandidateBatch>::iterator position = pending_batches_.begin();
+        while (position != pending_batches_.end() && !(batch.stamp_ < position->stamp_))
+            ++position;
+        pending_batches_.insert(position, batch);
+
+        fuseBatches(config);
+    }
+
+    /**
+     * Updates the tracks with the pending batches in the order of their stamps. A batch is fused
+     * once every scanner delivered a scan at least as recent, or when the newest batch is more than
+     * the sync tolerance ahead of it, so a silent scanner does not stall the others.
+     * Expects fusion_mutex_ to be locked.
+     */
+    void fuseBatches(const mcr_leg_detection::LegDetectionConfig& config)
+    {
+        size_t num_fused = 0;
+        for (; num_fused < pending_batches_.size(); num_fused++)
         {
-            Stamped < Point > loc((*cf_iter)->center(), scan->header.stamp, scan->header.frame_id);
-            try
-            {
-                tfl_.transformPoint(fixed_frame, loc, loc);
-            }
-            catch (...)
+            const CandidateBatch& batch = pending_batches_[num_fused];
+
+            bool synchronized = true;
+            for (size_t s = 0; s < sources_.size(); s++)
             {
-                ROS_WARN("TF exception spot 3.");
+                if (sources_[s]->latest_stamp_ < batch.stamp_)
+                    synchronized = false;
             }
 
-            list<SavedFeature*>::iterator closest = propagated.end();
-            float closest_dist = max_track_jump_m;
+            if (!synchronized && (pending_batches_.back().stamp_ - batch.stamp_).toSec() <= sync_tolerance_s_)
+                break;
 
-            for (list<SavedFeature*>::iterator pf_iter = propagated.begin(); pf_iter != propagated.end(); pf_iter++)
-            {
-                // find the closest distance between candidate and trackers
-                float dist = loc.distance((*pf_iter)->position_);
-                if (dist < closest_dist)
-                {
-                    closest = pf_iter;
-                    closest_dist = dist;
-                }
-            }
-            // Nothing close to it, start a new track
-            if (closest == propagated.end())
-            {
-                list<SavedFeature*>::iterator new_saved = saved_features_.insert(saved_features_.end(), new SavedFeature(loc, tfl_));
-            }
-            // Add the candidate, the tracker and the distance to a match list
-            else matches.insert(MatchedFeature(*cf_iter, *closest, closest_dist));
+            tracker_.predict(batch.stamp_);
+            tracker_.update(batch.candidates_, batch.full_scan_);
+            last_fused_stamp_ = batch.stamp_;
+
+            publishTracks(batch.stamp_, config);
         }
+        pending_batches_.erase(pending_batches_.begin(), pending_batches_.begin() + num_fused);
+    }
+
+    /** Publishes the tracks after the fusion of the candidates with the given stamp */
+    void publishTracks(const ros::Time& stamp, const mcr_leg_detection::LegDetectionConfig& config)
+    {
+        const LegTracker::TrackList& tracks = tracker_.getTracks();
 
-        // loop through _sorted_ matches list
-        // find the match with the shortest distance for each tracker
-        while (matches.size() > 0)
+        // injecting a TF frame per track is expensive, so it is only done on request
+        if (config.publish_track_frames)
         {
-            multiset<MatchedFeature>::iterator matched_iter = matches.begin();
-            bool found = false;
-            list<SavedFeature*>::iterator pf_iter = propagated.begin();
-            while (pf_iter != propagated.end())
+            for (size_t t = 0; t < tracks.size(); t++)
             {
-                // update the tracker with this candidate
-                if (matched_iter->closest_ == *pf_iter)
-                {
-                    // Transform candidate to fixed frame
-                    Stamped < Point > loc(matched_iter->candidate_->center(), scan->header.stamp, scan->header.frame_id);
-                    try
-                    {
-                        tfl_.transformPoint(fixed_frame, loc, loc);
-                    }
-                    catch (...)
-                    {
-                        ROS_WARN("TF exception spot 4.");
-                    }
-
-                    // Update the tracker with the candidate location
-                    matched_iter->closest_->update(loc);
-
-                    // remove this match and
-                    matches.erase(matched_iter);
-                    propagated.erase(pf_iter++);
-                    found = true;
-                    break;
-                }
-                // still looking for the tracker to update
-                else
-                {
-                    pf_iter++;
-                }
-            }
+                const Stamped<Point>& loc = tracks[t].meas_position_;
+                if (tracks[t].meas_time_ != stamp)
+                    continue;
 
-            // didn't find tracker to update, because it was deleted above
-            // try to assign the candidate to another tracker
-            if (!found)
-            {
-                Stamped < Point > loc(matched_iter->candidate_->center(), scan->header.stamp, scan->header.frame_id);
-                try
-                {
-                    tfl_.transformPoint(fixed_frame, loc, loc);
-                }
-                catch (...)
-                {
-                    ROS_WARN("TF exception spot 5.");
-                }
-
-                list<SavedFeature*>::iterator closest = propagated.end();
-                float closest_dist = max_track_jump_m;
-
-                for (list<SavedFeature*>::iterator remain_iter = propagated.begin(); remain_iter != propagated.end(); remain_iter++)
-                {
-                    float dist = loc.distance((*remain_iter)->position_);
-                    if (dist < closest_dist)
-                    {
-                        closest = remain_iter;
-                        closest_dist = dist;
-                    }
-                }
-
-                // no tracker is within a threshold of this candidate
-                // so create a new tracker for this candidate
-                if (closest == propagated.end()) list<SavedFeature*>::iterator new_saved = saved_features_.insert(saved_features_.end(),
-                            new SavedFeature(loc, tfl_));
-                else matches.insert(MatchedFeature(matched_iter->candidate_, *closest, closest_dist));
-                matches.erase(matched_iter);
+                StampedTransform pose(tf::Transform(Quaternion(0.0, 0.0, 0.0, 1.0), loc), loc.stamp_, tracks[t].id_,
+                                      loc.frame_id_);
+                tfl_.setTransform(pose);
             }
         }
 
-        cvReleaseMat(&tmp_mat);
-        tmp_mat = 0;
 
         /*
          * From here it's Fred's extension
@@ -489,16 +481,16 @@ public:
         double distance = 0, angle = 0;
         geometry_msgs::Quaternion quat;
 
-        for (list<SavedFeature*>::iterator sf_iter = saved_features_.begin(); sf_iter != saved_features_.end(); sf_iter++, i++)
+        for (size_t t = 0; t < tracks.size(); t++, i++)
         {
             // reliability
             StatePosVel est;
-            (*sf_iter)->filter_.getEstimate(est);
+            tracks[t].filter_.getEstimate(est);
 
             mcr_perception_msgs::Person person;
 
             person_list.header.frame_id = person.header.frame_id = person.pose.header.frame_id = fixed_frame;
-            person_list.header.stamp = person.header.stamp = person.pose.header.stamp = scan->header.stamp;
+            person_list.header.stamp = person.header.stamp = person.pose.header.stamp = stamp;
             person.id = 0;
             person.is_tracked = false;
             person.pose.pose.position.x = est.pos_[0];
@@ -514,7 +506,7 @@ public:
         //publish detected legs
         pub_legs_.publish(person_list);
 
-        if (dyn_recfg_config_.publish_visualization_marker)
+        if (config.publish_visualization_marker)
             publishVisualizationMarker(person_list);
     }
 };
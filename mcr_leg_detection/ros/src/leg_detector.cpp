@@ -0,0 +1,340 @@
+/*
+ * Copyright 2018 Bonn-Rhein-Sieg University
+ */
+#include "mcr_leg_detection/leg_detector.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+using namespace laser_processor;
+using namespace estimation;
+using namespace tf;
+
+namespace
+{
+const double no_observation_timeout_s = 0.5;
+const double max_track_jump_m = 1.0;
+const uint32_t min_cluster_size = 5;
+
+typedef chrono::steady_clock Clock;
+
+double secondsSince(Clock::time_point& start)
+{
+    Clock::time_point now = Clock::now();
+    double seconds = chrono::duration<double>(now - start).count();
+    start = now;
+    return seconds;
+}
+}
+
+int LegTrack::nextid = 0;
+
+LegTrack::LegTrack(const Stamped<Point>& loc)
+    : sys_sigma_(Vector3(0.05, 0.05, 0.05), Vector3(1.0, 1.0, 1.0)),
+      filter_("tracker_name", sys_sigma_),
+      meas_position_(loc),
+      position_(loc),
+      dist_to_person_(0)
+{
+    char id[100];
+    snprintf(id, 100, "legtrack%d", nextid++);
+    id_ = std::string(id);
+
+    object_id = "";
+    time_ = loc.stamp_;
+    meas_time_ = loc.stamp_;
+
+    BFL::StatePosVel prior_sigma(Vector3(0.1, 0.1, 0.1), Vector3(0.0000001, 0.0000001, 0.0000001));
+    filter_.initialize(loc, prior_sigma, time_.toSec());
+
+    updatePosition();
+}
+
+void LegTrack::propagate(ros::Time time)
+{
+    time_ = time;
+
+    filter_.updatePrediction(time.toSec());
+
+    updatePosition();
+}
+
+void LegTrack::update(const Stamped<Point>& loc)
+{
+    meas_position_ = loc;
+    meas_time_ = loc.stamp_;
+    time_ = meas_time_;
+
+    Eigen::Matrix3d cov = Eigen::Matrix3d::Identity() * 0.0025;
+
+    filter_.updateCorrection(loc, cov);
+
+    updatePosition();
+}
+
+void LegTrack::updatePosition()
+{
+    BFL::StatePosVel est;
+    filter_.getEstimate(est);
+
+    position_[0] = est.pos_[0];
+    position_[1] = est.pos_[1];
+    position_[2] = est.pos_[2];
+    position_.stamp_ = time_;
+    position_.frame_id_ = meas_position_.frame_id_;
+}
+
+LegCandidateDetector::LegCandidateDetector(const string& fixed_frame)
+    : fixed_frame_(fixed_frame),
+      connected_thresh_(0.06),
+      feature_mask_(ALL_LEG_FEATURES),
+      scans_since_full_scan_(0),
+      full_scan_(true),
+      num_clusters_(0)
+{
+}
+
+bool LegCandidateDetector::setForest(const FlatForest& forest)
+{
+    if (forest.empty() || forest.getVarCount() > LEG_FEATURE_COUNT)
+        return false;
+
+    forest_ = forest;
+
+    vector<int> num_splits;
+    forest_.getVarUsage(num_splits);
+
+    feature_mask_ = 0;
+    for (size_t f = 0; f < num_splits.size(); f++)
+    {
+        if (num_splits[f] > 0)
+            feature_mask_ |= 1u << f;
+    }
+
+    return true;
+}
+
+void LegCandidateDetector::updateBackground(const sensor_msgs::LaserScan& scan, const Transform* scan_to_fixed,
+                                            bool scanner_stationary, const vector<Point>& track_positions)
+{
+    // the background of a moving scanner is outdated and has to be learned again
+    if (!params_.background_learning_enabled || !scanner_stationary)
+    {
+        mask_.clear();
+        return;
+    }
+
+    // A person who stops in front of the robot must not become background, so the beams of the
+    // leg candidates and the beams around the tracks are not learned. A track too close to the
+    // scanner covers most of the scan, which is then not learned at all.
+    background_excluded_.clear();
+    if (!track_positions.empty() &&
+        (!scan_to_fixed || !computeTrackWindows(scan, *scan_to_fixed, track_positions, background_excluded_)))
+        return;
+
+    vector<SampleSet>& clusters = processor_.getClusters();
+    for (size_t i = 0; i < num_clusters_; i++)
+    {
+        if (responses_.at<float>(i) <= 0)
+            continue;
+
+        uint32_t first = clusters[i].front().index, last = first;
+        for (SampleSet::iterator s = clusters[i].begin(); s != clusters[i].end(); ++s)
+        {
+            first = min<uint32_t>(first, s->index);
+            last = max<uint32_t>(last, s->index);
+        }
+        background_excluded_.push_back(BeamWindow(first, last + 1));
+    }
+    mergeBeamWindows(background_excluded_);
+
+    mask_.setLearningParameters(params_.background_decay, params_.background_min_scans);
+    mask_.addScan(scan, cartesian_scan_, background_excluded_);
+}
+
+bool LegCandidateDetector::computeTrackWindows(const sensor_msgs::LaserScan& scan, const Transform& scan_to_fixed,
+                                               const vector<Point>& track_positions, vector<BeamWindow>& windows)
+{
+    if (scan.angle_increment <= 0.0)
+        return false;
+
+    Transform fixed_to_scan = scan_to_fixed.inverse();
+    double margin = params_.roi_margin;
+    double num_beams = scan.ranges.size();
+    double beams_per_turn = 2.0 * M_PI / scan.angle_increment;
+
+    windows.clear();
+    for (size_t t = 0; t < track_positions.size(); t++)
+    {
+        Point p = fixed_to_scan * track_positions[t];
+        double distance = sqrt(p.x() * p.x() + p.y() * p.y());
+        if (!(distance > margin))
+            return false;
+
+        // the beams which pass the circle with the margin around the track, the bearing is taken
+        // within one revolution after angle_min, so tracks at the seam of a 360 degree scan are kept
+        double offset = fmod(atan2(p.y(), p.x()) - scan.angle_min, 2.0 * M_PI);
+        if (offset < 0.0)
+            offset += 2.0 * M_PI;
+        double center = offset / scan.angle_increment;
+        double half_width = asin(margin / distance) / scan.angle_increment;
+
+        // a window which crosses the start or the end of the revolution continues at the other end
+        for (int turn = -1; turn <= 1; turn++)
+        {
+            double first = max(0.0, floor(center - half_width + turn * beams_per_turn));
+            double last = min(num_beams, ceil(center + half_width + turn * beams_per_turn) + 1.0);
+
+            if (first < last)
+                windows.push_back(BeamWindow(static_cast<uint32_t>(first), static_cast<uint32_t>(last)));
+        }
+    }
+    mergeBeamWindows(windows);
+
+    return true;
+}
+
+void LegCandidateDetector::detect(const sensor_msgs::LaserScan& scan, const Transform* scan_to_fixed,
+                                  bool scanner_stationary, const vector<Point>& track_positions)
+{
+    Clock::time_point start = Clock::now();
+
+    scan_geometry_.toCartesian(scan, cartesian_scan_);
+
+    // In the ROI mode only the beams around the tracks are processed between the full scans,
+    // which keep looking for new people
+    full_scan_ = !params_.roi_enabled || track_positions.empty() || !scan_to_fixed ||
+                 scans_since_full_scan_ + 1 >= params_.roi_full_scan_period ||
+                 !computeTrackWindows(scan, *scan_to_fixed, track_positions, roi_windows_);
+
+    // the background is removed before the clustering, so walls and furniture do not
+    // reach the feature extraction and the classifier
+    if (full_scan_)
+    {
+        processor_.setScan(scan, cartesian_scan_, mask_);
+        scans_since_full_scan_ = 0;
+    }
+    else
+    {
+        processor_.setScan(scan, cartesian_scan_, mask_, roi_windows_);
+        scans_since_full_scan_++;
+    }
+
+    processor_.splitConnected(connected_thresh_);
+    processor_.removeLessThan(min_cluster_size);
+
+    timings_.segmentation = secondsSince(start);
+
+    // Detection step: the features of all clusters are classified by a single call of the forest
+    vector<SampleSet>& clusters = processor_.getClusters();
+    num_clusters_ = clusters.size();
+
+    if (features_.rows < static_cast<int>(num_clusters_))
+        features_.create(num_clusters_, LEG_FEATURE_COUNT, CV_32FC1);
+
+    for (size_t i = 0; i < num_clusters_; i++)
+        calcLegFeatures(clusters[i], cartesian_scan_, features_.ptr<float>(i), feature_mask_);
+
+    timings_.features = secondsSince(start);
+
+    // Transform the candidates to the fixed frame
+    candidates_.clear();
+    if (num_clusters_ > 0)
+    {
+        forest_.predict(features_.rowRange(0, num_clusters_), responses_);
+
+        const string& frame = scan_to_fixed ? fixed_frame_ : scan.header.frame_id;
+        Transform to_fixed = scan_to_fixed ? *scan_to_fixed : Transform::getIdentity();
+
+        for (size_t i = 0; i < num_clusters_; i++)
+        {
+            if (responses_.at<float>(i) > 0)
+                candidates_.push_back(Stamped<Point>(to_fixed * clusters[i].center(), scan.header.stamp, frame));
+        }
+    }
+
+    timings_.classification = secondsSince(start);
+
+    // learned after the classification, which tells the beams of the people
+    updateBackground(scan, scan_to_fixed, scanner_stationary, track_positions);
+}
+
+LegTracker::LegTracker()
+    : association_(max_track_jump_m)
+{
+}
+
+void LegTracker::predict(const ros::Time& stamp)
+{
+    // if no measurement matches to a tracker in the last <no_observation_timeout>  seconds: erase tracker
+    ros::Time purge = stamp + ros::Duration().fromSec(-no_observation_timeout_s);
+    size_t num_remaining = 0;
+    for (size_t t = 0; t < tracks_.size(); t++)
+    {
+        if (!(tracks_[t].meas_time_ < purge))
+        {
+            if (num_remaining != t)
+                tracks_[num_remaining] = tracks_[t];
+            num_remaining++;
+        }
+    }
+    tracks_.erase(tracks_.begin() + num_remaining, tracks_.end());
+
+    // System update of all remaining trackers
+    for (size_t t = 0; t < tracks_.size(); t++)
+        tracks_[t].propagate(stamp);
+}
+
+void LegTracker::update(const vector<Stamped<Point> >& candidates, bool allow_new_tracks)
+{
+    getPositions(track_positions_);
+
+    candidate_positions_.assign(candidates.begin(), candidates.end());
+
+    // Assign the candidates to the trackers within max_track_jump_m, minimizing the total distance
+    association_.associate(track_positions_, candidate_positions_, assignment_);
+
+    for (size_t c = 0; c < candidates.size(); c++)
+    {
+        // Update the assigned tracker with the candidate location
+        if (assignment_[c] >= 0)
+            tracks_[assignment_[c]].update(candidates[c]);
+        // Nothing close to it, start a new track. Clusters cut at the border of a window
+        // can look like legs, so only full scans start tracks.
+        else if (allow_new_tracks)
+            tracks_.push_back(LegTrack(candidates[c]));
+    }
+}
+
+void LegTracker::getPositions(vector<Point>& positions) const
+{
+    positions.clear();
+    for (size_t t = 0; t < tracks_.size(); t++)
+        positions.push_back(tracks_[t].position_);
+}
+
+LegDetector::LegDetector(const string& fixed_frame)
+    : detector_(fixed_frame)
+{
+}
+
+void LegDetector::processScan(const sensor_msgs::LaserScan& scan, const Transform* scan_to_fixed,
+                              bool scanner_stationary)
+{
+    // the windows of the ROI mode are placed around the predicted tracks
+    Clock::time_point start = Clock::now();
+    tracker_.predict(scan.header.stamp);
+    tracker_.getPositions(track_positions_);
+    double prediction = secondsSince(start);
+
+    detector_.detect(scan, scan_to_fixed, scanner_stationary, track_positions_);
+
+    start = Clock::now();
+    tracker_.update(detector_.getCandidates(), detector_.wasFullScan());
+
+    timings_ = detector_.getTimings();
+    timings_.tracking = prediction + secondsSince(start);
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2018 Bonn-Rhein-Sieg University
+ *
+ * Writes a trained leg classifier as a C++ header, which is compiled into leg_detection_node
+ * with the CMake option LEG_DETECTION_COMPILED_FOREST.
+ *
+ * Usage: leg_forest_codegen <trained_forest.yaml> <output.h>
+ *
+ */
+#include <stdio.h>
+#include <fstream>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/ml/ml.hpp>
+
+#include "mcr_leg_detection/calc_leg_features.h"
+#include "mcr_leg_detection/flat_forest.h"
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        printf("Usage: %s <trained_forest.yaml> <output.h>\n", argv[0]);
+        return 1;
+    }
+
+    cv::Ptr<cv::ml::RTrees> trained_forest = cv::Algorithm::load<cv::ml::RTrees>(argv[1]);
+    FlatForest forest;
+    if (trained_forest.empty() || !forest.load(*trained_forest))
+    {
+        printf("Could not load a random forests classifier from %s\n", argv[1]);
+        return 1;
+    }
+
+    if (forest.getVarCount() > LEG_FEATURE_COUNT)
+    {
+        printf("The forest uses %d features, but there are only %d leg features\n", forest.getVarCount(),
+               LEG_FEATURE_COUNT);
+        return 1;
+    }
+
+    std::ofstream out(argv[2]);
+    forest.writeCode(out, "compiled_leg_forest", std::string("Leg classifier compiled from ") + argv[1]);
+    out.close();
+
+    if (!out)
+    {
+        printf("Could not write %s\n", argv[2]);
+        return 1;
+    }
+
+    return 0;
+}
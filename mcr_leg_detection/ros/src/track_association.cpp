@@ -0,0 +1,268 @@
+/*
+ * Copyright 2018 Bonn-Rhein-Sieg University
+ */
+#include "mcr_leg_detection/track_association.h"
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+using namespace std;
+
+namespace estimation
+{
+
+namespace
+{
+// positions beyond this are treated as broken estimates and never associated
+const double MAX_COORDINATE = 1e6;
+
+inline bool isUsable(const tf::Point& p)
+{
+    return fabs(p.x()) < MAX_COORDINATE && fabs(p.y()) < MAX_COORDINATE;
+}
+}
+
+TrackAssociation::TrackAssociation(double gate) : gate_(gate)
+{
+}
+
+int64_t TrackAssociation::cellKey(int64_t cx, int64_t cy) const
+{
+    return static_cast<int64_t>((static_cast<uint64_t>(cx) << 32) | static_cast<uint32_t>(cy));
+}
+
+int TrackAssociation::findGroup(int node)
+{
+    while (group_parent_[node] != node)
+    {
+        group_parent_[node] = group_parent_[group_parent_[node]];
+        node = group_parent_[node];
+    }
+    return node;
+}
+
+void TrackAssociation::associate(const vector<tf::Point>& tracks, const vector<tf::Point>& detections,
+                                 vector<int>& assignment)
+{
+    int num_tracks = tracks.size();
+    int num_detections = detections.size();
+
+    assignment.assign(num_detections, -1);
+    if (num_tracks == 0 || num_detections == 0)
+        return;
+
+    // bucket the tracks
+    grid_.clear();
+    for (int t = 0; t < num_tracks; ++t)
+    {
+        if (!isUsable(tracks[t]))
+            continue;
+
+        int64_t cx = static_cast<int64_t>(floor(tracks[t].x() / gate_));
+        int64_t cy = static_cast<int64_t>(floor(tracks[t].y() / gate_));
+        grid_.push_back(make_pair(cellKey(cx, cy), t));
+    }
+    sort(grid_.begin(), grid_.end());
+
+    // gating: collect all pairs closer than the gate from the neighbouring cells
+    pairs_.clear();
+    for (int d = 0; d < num_detections; ++d)
+    {
+        if (!isUsable(detections[d]))
+            continue;
+
+        int64_t cx = static_cast<int64_t>(floor(detections[d].x() / gate_));
+        int64_t cy = static_cast<int64_t>(floor(detections[d].y() / gate_));
+
+        for (int64_t nx = cx - 1; nx <= cx + 1; ++nx)
+        {
+            for (int64_t ny = cy - 1; ny <= cy + 1; ++ny)
+            {
+                int64_t key = cellKey(nx, ny);
+                vector<pair<int64_t, int> >::const_iterator cell =
+                    lower_bound(grid_.begin(), grid_.end(), make_pair(key, numeric_limits<int>::min()));
+
+                for (; cell != grid_.end() && cell->first == key; ++cell)
+                {
+                    double distance = detections[d].distance(tracks[cell->second]);
+                    if (distance < gate_)
+                    {
+                        Pair p;
+                        p.detection = d;
+                        p.track = cell->second;
+                        p.distance = distance;
+                        pairs_.push_back(p);
+                    }
+                }
+            }
+        }
+    }
+
+    if (pairs_.empty())
+        return;
+
+    // split the gated pairs into independent groups
+    group_parent_.resize(num_detections + num_tracks);
+    for (size_t i = 0; i < group_parent_.size(); ++i)
+        group_parent_[i] = i;
+
+    for (size_t i = 0; i < pairs_.size(); ++i)
+    {
+        int a = findGroup(pairs_[i].detection);
+        int b = findGroup(num_detections + pairs_[i].track);
+        if (a != b)
+            group_parent_[a] = b;
+    }
+
+    group_index_.assign(num_detections + num_tracks, -1);
+    int num_groups = 0;
+    for (size_t i = 0; i < pairs_.size(); ++i)
+    {
+        int root = findGroup(pairs_[i].detection);
+        if (group_index_[root] < 0)
+        {
+            group_index_[root] = num_groups++;
+            if (group_pairs_.size() < static_cast<size_t>(num_groups))
+                group_pairs_.resize(num_groups);
+            group_pairs_[num_groups - 1].clear();
+        }
+        group_pairs_[group_index_[root]].push_back(i);
+    }
+
+    for (int g = 0; g < num_groups; ++g)
+        solveGroup(group_pairs_[g], assignment);
+}
+
+void TrackAssociation::solveGroup(const vector<int>& pair_indices, vector<int>& assignment)
+{
+    // a single pair needs no optimization, which is the common case of well separated legs
+    if (pair_indices.size() == 1)
+    {
+        const Pair& p = pairs_[pair_indices[0]];
+        assignment[p.detection] = p.track;
+        return;
+    }
+
+    rows_.clear();
+    cols_.clear();
+    for (size_t i = 0; i < pair_indices.size(); ++i)
+    {
+        rows_.push_back(pairs_[pair_indices[i]].detection);
+        cols_.push_back(pairs_[pair_indices[i]].track);
+    }
+    sort(rows_.begin(), rows_.end());
+    rows_.erase(unique(rows_.begin(), rows_.end()), rows_.end());
+    sort(cols_.begin(), cols_.end());
+    cols_.erase(unique(cols_.begin(), cols_.end()), cols_.end());
+
+    // the Hungarian method needs at most as many rows as columns
+    bool tracks_are_rows = rows_.size() > cols_.size();
+    if (tracks_are_rows)
+        rows_.swap(cols_);
+
+    int num_rows = rows_.size();
+    int num_cols = cols_.size();
+
+    // pairs outside of the gate cost more than any assignment within the gate, so the solution
+    // assigns as many detections as possible
+    const double outside_gate = gate_ * (num_rows + 1);
+    cost_.assign(num_rows * num_cols, outside_gate);
+
+    for (size_t i = 0; i < pair_indices.size(); ++i)
+    {
+        const Pair& p = pairs_[pair_indices[i]];
+        int row_id = tracks_are_rows ? p.track : p.detection;
+        int col_id = tracks_are_rows ? p.detection : p.track;
+        int r = lower_bound(rows_.begin(), rows_.end(), row_id) - rows_.begin();
+        int c = lower_bound(cols_.begin(), cols_.end(), col_id) - cols_.begin();
+        cost_[r * num_cols + c] = p.distance;
+    }
+
+    solveHungarian(num_rows, num_cols);
+
+    for (int c = 0; c < num_cols; ++c)
+    {
+        int r = col_match_[c + 1] - 1;
+        if (r < 0 || cost_[r * num_cols + c] >= gate_)
+            continue;
+
+        if (tracks_are_rows)
+            assignment[cols_[c]] = rows_[r];
+        else
+            assignment[rows_[r]] = cols_[c];
+    }
+}
+
+void TrackAssociation::solveHungarian(int num_rows, int num_cols)
+{
+    const double infinity = numeric_limits<double>::infinity();
+
+    // potentials and matching are 1-based, column 0 is a virtual column for the row being added
+    row_potential_.assign(num_rows + 1, 0.0);
+    col_potential_.assign(num_cols + 1, 0.0);
+    col_match_.assign(num_cols + 1, 0);
+    col_way_.assign(num_cols + 1, 0);
+
+    for (int i = 1; i <= num_rows; ++i)
+    {
+        col_match_[0] = i;
+        int j0 = 0;
+        min_slack_.assign(num_cols + 1, infinity);
+        col_used_.assign(num_cols + 1, 0);
+
+        // grow an alternating tree until it reaches a free column
+        do
+        {
+            col_used_[j0] = 1;
+            int i0 = col_match_[j0];
+            double delta = infinity;
+            int j1 = 0;
+
+            for (int j = 1; j <= num_cols; ++j)
+            {
+                if (col_used_[j])
+                    continue;
+
+                double slack = cost_[(i0 - 1) * num_cols + (j - 1)] - row_potential_[i0] - col_potential_[j];
+                if (slack < min_slack_[j])
+                {
+                    min_slack_[j] = slack;
+                    col_way_[j] = j0;
+                }
+                if (min_slack_[j] < delta)
+                {
+                    delta = min_slack_[j];
+                    j1 = j;
+                }
+            }
+
+            for (int j = 0; j <= num_cols; ++j)
+            {
+                if (col_used_[j])
+                {
+                    row_potential_[col_match_[j]] += delta;
+                    col_potential_[j] -= delta;
+                }
+                else
+                {
+                    min_slack_[j] -= delta;
+                }
+            }
+
+            j0 = j1;
+        }
+        while (col_match_[j0] != 0);
+
+        // flip the augmenting path
+        do
+        {
+            int j1 = col_way_[j0];
+            col_match_[j0] = col_match_[j1];
+            j0 = j1;
+        }
+        while (j0 != 0);
+    }
+}
+
+}  // namespace estimation
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2018 Bonn-Rhein-Sieg University
+ *
+ * Compares the predictions of FlatForest with the ones of the cv::ml::RTrees it was flattened from.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <float.h>
+#include <math.h>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/ml/ml.hpp>
+
+#include "mcr_leg_detection/flat_forest.h"
+
+namespace
+{
+const int NUM_FEATURES = 14;
+
+// three classes with overlapping, feature dependent regions, so the trees get deep
+void createSamples(cv::RNG& rng, int num_samples, cv::Mat& samples, cv::Mat& responses)
+{
+    samples.create(num_samples, NUM_FEATURES, CV_32FC1);
+    responses.create(num_samples, 1, CV_32SC1);
+    rng.fill(samples, cv::RNG::UNIFORM, -1.0, 1.0);
+
+    for (int i = 0; i < num_samples; ++i)
+    {
+        const float* s = samples.ptr<float>(i);
+        float score = s[0] * s[3] + 0.5f * s[7] - s[11] * s[11] + 0.2f * static_cast<float>(rng.gaussian(1.0));
+        responses.at<int>(i) = (score > 0.2f) ? 1 : ((score < -0.4f) ? -1 : 0);
+    }
+}
+
+cv::Ptr<cv::ml::RTrees> trainForest(cv::RNG& rng)
+{
+    cv::Mat samples, responses;
+    createSamples(rng, 600, samples, responses);
+
+    cv::Ptr<cv::ml::RTrees> forest = cv::ml::RTrees::create();
+    forest->setMaxDepth(10);
+    forest->setMinSampleCount(2);
+    forest->setActiveVarCount(4);
+    forest->setTermCriteria(cv::TermCriteria(cv::TermCriteria::MAX_ITER, 25, 0.0));
+    forest->train(cv::ml::TrainData::create(samples, cv::ml::ROW_SAMPLE, responses));
+    return forest;
+}
+}  // namespace
+
+TEST(flat_forest_test, matches_rtrees_prediction)
+{
+    cv::RNG rng(42);
+    cv::Ptr<cv::ml::RTrees> trained = trainForest(rng);
+    ASSERT_TRUE(trained->isTrained());
+
+    FlatForest forest;
+    ASSERT_TRUE(forest.load(*trained));
+    EXPECT_LE(forest.getVarCount(), NUM_FEATURES);
+
+    cv::Mat samples, unused;
+    createSamples(rng, 500, samples, unused);
+
+    // missing values and NaN take their own paths through the trees
+    for (int i = 0; i < samples.rows; i += 7)
+        samples.at<float>(i, i % NUM_FEATURES) = FLT_MAX;
+    for (int i = 3; i < samples.rows; i += 11)
+        samples.at<float>(i, i % NUM_FEATURES) = NAN;
+
+    cv::Mat responses;
+    forest.predict(samples, responses);
+    ASSERT_EQ(samples.rows, responses.rows);
+
+    for (int i = 0; i < samples.rows; ++i)
+    {
+        float expected = trained->predict(samples.row(i));
+        EXPECT_EQ(expected, responses.at<float>(i)) << "sample " << i;
+        EXPECT_EQ(expected, forest.predict(samples.ptr<float>(i))) << "sample " << i;
+    }
+}
+
+TEST(flat_forest_test, follows_inversed_splits)
+{
+    cv::RNG rng(7);
+    cv::Ptr<cv::ml::RTrees> trained = trainForest(rng);
+    ASSERT_TRUE(trained->isTrained());
+
+    // training only creates splits which send the samples <= c to the left, loaded models can
+    // contain inversed ones, so every other split of the trained forest is turned around
+    std::vector<cv::ml::DTrees::Split>& splits = const_cast<std::vector<cv::ml::DTrees::Split>&>(trained->getSplits());
+    for (size_t i = 0; i < splits.size(); i += 2)
+        splits[i].inversed = !splits[i].inversed;
+
+    FlatForest forest;
+    ASSERT_TRUE(forest.load(*trained));
+
+    cv::Mat samples, unused;
+    createSamples(rng, 500, samples, unused);
+    for (int i = 0; i < samples.rows; i += 7)
+        samples.at<float>(i, i % NUM_FEATURES) = FLT_MAX;
+
+    for (int i = 0; i < samples.rows; ++i)
+        EXPECT_EQ(trained->predict(samples.row(i)), forest.predict(samples.ptr<float>(i))) << "sample " << i;
+}
+
+TEST(flat_forest_test, counts_splits_per_variable)
+{
+    // two trees, the first splits on variables 0 and 3, the second is a single leaf
+    const FlatForest::Node nodes[] =
+    {
+        { 0, 0.5f, { 1, 2 }, 2 },
+        { -1, 0.0f, { 0, 0 }, 0 },
+        { 3, -0.25f, { 3, 4 }, 3 },
+        { -1, 0.0f, { 1, 1 }, 1 },
+        { -1, 0.0f, { 0, 0 }, 0 },
+        { -1, 0.0f, { 1, 1 }, 1 },
+    };
+    const int32_t roots[] = { 0, 5 };
+    const float class_labels[] = { -1.0f, 1.0f };
+
+    FlatForest forest;
+    forest.assign(nodes, 6, roots, 2, class_labels, 2);
+    ASSERT_EQ(4, forest.getVarCount());
+
+    std::vector<int> num_splits;
+    forest.getVarUsage(num_splits);
+    ASSERT_EQ(4u, num_splits.size());
+    EXPECT_EQ(1, num_splits[0]);
+    EXPECT_EQ(0, num_splits[1]);
+    EXPECT_EQ(0, num_splits[2]);
+    EXPECT_EQ(1, num_splits[3]);
+
+    // the unused variables do not change the prediction
+    float sample[4] = { 0.7f, 3.0f, -8.0f, -1.0f };
+    EXPECT_EQ(1.0f, forest.predict(sample));
+    sample[1] = 0.0f;
+    sample[2] = 0.0f;
+    EXPECT_EQ(1.0f, forest.predict(sample));
+    sample[3] = 1.0f;
+    EXPECT_EQ(-1.0f, forest.predict(sample));
+}
+
+TEST(flat_forest_test, rejects_forest_on_variable_subset)
+{
+    cv::RNG rng(11);
+    cv::Mat samples, responses;
+    createSamples(rng, 600, samples, responses);
+
+    // the splits of this forest index the selected variables, not the columns of the samples
+    cv::Mat var_idx = (cv::Mat_<int>(1, 4) << 11, 7, 3, 0);
+    cv::Ptr<cv::ml::RTrees> trained = cv::ml::RTrees::create();
+    trained->setMaxDepth(10);
+    trained->setMinSampleCount(2);
+    trained->setTermCriteria(cv::TermCriteria(cv::TermCriteria::MAX_ITER, 10, 0.0));
+    trained->train(cv::ml::TrainData::create(samples, cv::ml::ROW_SAMPLE, responses, var_idx));
+    ASSERT_TRUE(trained->isTrained());
+
+    FlatForest forest;
+    EXPECT_FALSE(forest.load(*trained));
+    EXPECT_TRUE(forest.empty());
+}
+
+TEST(flat_forest_test, rejects_untrained_forest)
+{
+    cv::Ptr<cv::ml::RTrees> untrained = cv::ml::RTrees::create();
+    FlatForest forest;
+    EXPECT_FALSE(forest.load(*untrained));
+    EXPECT_TRUE(forest.empty());
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,361 @@
+/*
+ * Copyright 2018 Bonn-Rhein-Sieg University
+ *
+ * Tests the ScanMask and compares the clusters of ScanProcessor::splitConnected with the ones
+ * of the original set based implementation on simulated scans of legs in front of walls.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include <sensor_msgs/LaserScan.h>
+#include <mcr_scan_geometry/scan_geometry.h>
+#include "mcr_leg_detection/laser_processor.h"
+
+using laser_processor::BeamWindow;
+using laser_processor::mergeBeamWindows;
+using laser_processor::Sample;
+using laser_processor::SampleSet;
+using laser_processor::ScanMask;
+using laser_processor::ScanProcessor;
+
+namespace
+{
+typedef std::vector<std::vector<int> > ClusterIndices;
+
+// deterministic pseudo random numbers, so that every run sees the same scans
+class Random
+{
+    unsigned int state_;
+
+public:
+    explicit Random(unsigned int seed) : state_(seed) {}
+
+    // uniform in [min, max)
+    double uniform(double min, double max)
+    {
+        state_ = state_ * 1664525u + 1013904223u;
+        return min + (max - min) * ((state_ >> 8) / 16777216.0);
+    }
+};
+
+// distance along the ray (cos_a, sin_a) to a circle, or a negative value if it is missed
+double intersectCircle(double cos_a, double sin_a, double cx, double cy, double radius)
+{
+    double b = cos_a * cx + sin_a * cy;
+    double c = cx * cx + cy * cy - radius * radius;
+    double d = b * b - c;
+
+    if (d < 0.0)
+        return -1.0;
+
+    return b - sqrt(d);
+}
+
+/** Simulates a scanner in a rectangular room with a few people standing in it. Besides
+  * the sensor noise, some beams are lost or hit the edges of the legs. */
+sensor_msgs::LaserScan simulateScan(Random& random)
+{
+    sensor_msgs::LaserScan scan;
+    scan.angle_min = -2.0;
+    scan.angle_increment = 0.0061;
+    scan.range_min = 0.02;
+    scan.range_max = 5.6;
+
+    const int num_beams = 655;
+    scan.angle_max = scan.angle_min + (num_beams - 1) * scan.angle_increment;
+
+    double wall_front = random.uniform(2.0, 6.0);
+    double wall_left = random.uniform(1.0, 4.0);
+    double wall_right = random.uniform(1.0, 4.0);
+    double wall_back = random.uniform(0.5, 2.0);
+
+    std::vector<double> leg_x, leg_y;
+    int num_people = static_cast<int>(random.uniform(0.0, 5.0));
+    for (int p = 0; p < num_people; ++p)
+    {
+        double px = random.uniform(0.3, wall_front - 0.3);
+        double py = random.uniform(-wall_right + 0.3, wall_left - 0.3);
+        double heading = random.uniform(-M_PI, M_PI);
+        double stride = random.uniform(0.0, 0.4);
+
+        leg_x.push_back(px + cos(heading) * stride / 2 - sin(heading) * 0.1);
+        leg_y.push_back(py + sin(heading) * stride / 2 + cos(heading) * 0.1);
+        leg_x.push_back(px - cos(heading) * stride / 2 + sin(heading) * 0.1);
+        leg_y.push_back(py - sin(heading) * stride / 2 - cos(heading) * 0.1);
+    }
+
+    for (int i = 0; i < num_beams; ++i)
+    {
+        double angle = scan.angle_min + i * scan.angle_increment;
+        double cos_a = cos(angle);
+        double sin_a = sin(angle);
+
+        double range = 1e9;
+        if (cos_a > 1e-9)
+            range = std::min(range, wall_front / cos_a);
+        if (cos_a < -1e-9)
+            range = std::min(range, -wall_back / cos_a);
+        if (sin_a > 1e-9)
+            range = std::min(range, wall_left / sin_a);
+        if (sin_a < -1e-9)
+            range = std::min(range, -wall_right / sin_a);
+
+        for (size_t l = 0; l < leg_x.size(); ++l)
+        {
+            double leg_range = intersectCircle(cos_a, sin_a, leg_x[l], leg_y[l], 0.06);
+            if (leg_range > 0.0 && leg_range < range)
+                range = leg_range;
+        }
+
+        double event = random.uniform(0.0, 1.0);
+        if (event < 0.02)
+            range = 0.0;                                        // no return
+        else if (event < 0.04)
+            range = random.uniform(0.05, range);                // mixed pixel or dust
+        else
+            range += random.uniform(-0.015, 0.015);
+
+        scan.ranges.push_back(static_cast<float>(range));
+    }
+
+    return scan;
+}
+
+/** The original implementation of ScanProcessor::splitConnected, which grows every cluster
+  * with a queue over the set of remaining samples. */
+ClusterIndices referenceSplitConnected(const std::vector<Sample>& samples, float thresh, float angle_increment)
+{
+    ClusterIndices clusters;
+    std::set<int> remaining;
+    for (size_t i = 0; i < samples.size(); ++i)
+        remaining.insert(i);
+
+    while (!remaining.empty())
+    {
+        std::vector<int> queue;
+        queue.push_back(*remaining.begin());
+        remaining.erase(remaining.begin());
+
+        for (size_t q = 0; q < queue.size(); ++q)
+        {
+            const Sample& s_q = samples[queue[q]];
+            int expand = static_cast<int>(asin(thresh / s_q.range) / angle_increment);
+
+            std::set<int>::iterator r = remaining.begin();
+            while (r != remaining.end() && samples[*r].index < s_q.index + expand)
+            {
+                const Sample& rest = samples[*r];
+                if (rest.range - s_q.range > thresh)
+                {
+                    break;
+                }
+                else if (sqrt(pow(s_q.x - rest.x, 2.0f) + pow(s_q.y - rest.y, 2.0f)) < thresh)
+                {
+                    queue.push_back(*r);
+                    remaining.erase(r);
+                    break;
+                }
+                ++r;
+            }
+        }
+
+        std::vector<int> indices;
+        for (size_t q = 0; q < queue.size(); ++q)
+            indices.push_back(samples[queue[q]].index);
+        std::sort(indices.begin(), indices.end());
+        clusters.push_back(indices);
+    }
+
+    return clusters;
+}
+
+ClusterIndices toIndices(const std::vector<SampleSet>& clusters)
+{
+    ClusterIndices indices(clusters.size());
+    for (size_t c = 0; c < clusters.size(); ++c)
+        for (SampleSet::iterator s = clusters[c].begin(); s != clusters[c].end(); ++s)
+            indices[c].push_back(s->index);
+
+    return indices;
+}
+}  // namespace
+
+TEST(laser_processor_test, split_connected_matches_reference)
+{
+    const float thresholds[] = { 0.03, 0.06, 0.1 };
+    const int num_scans = 200;
+
+    Random random(42);
+    ScanGeometry scan_geometry;
+    CartesianScan cartesian_scan;
+    ScanMask mask;
+    ScanProcessor processor;
+    size_t num_clusters = 0;
+
+    for (int n = 0; n < num_scans; ++n)
+    {
+        sensor_msgs::LaserScan scan = simulateScan(random);
+        scan_geometry.toCartesian(scan, cartesian_scan);
+
+        std::vector<Sample> samples;
+        Sample s;
+        for (size_t i = 0; i < scan.ranges.size(); ++i)
+            if (Sample::Extract(i, cartesian_scan, s))
+                samples.push_back(s);
+
+        for (size_t t = 0; t < sizeof(thresholds) / sizeof(thresholds[0]); ++t)
+        {
+            processor.setScan(scan, cartesian_scan, mask);
+            processor.splitConnected(thresholds[t]);
+
+            ClusterIndices expected = referenceSplitConnected(samples, thresholds[t], scan.angle_increment);
+            ClusterIndices actual = toIndices(processor.getClusters());
+
+            ASSERT_EQ(expected, actual) << "scan " << n << ", threshold " << thresholds[t];
+            num_clusters += actual.size();
+        }
+    }
+
+    // make sure that the scans actually contain something to split
+    EXPECT_GT(num_clusters, 10u * num_scans);
+}
+
+TEST(laser_processor_test, scan_mask_removes_learned_background)
+{
+    sensor_msgs::LaserScan scan;
+    scan.angle_min = -1.0;
+    scan.angle_increment = 0.01;
+    scan.angle_max = scan.angle_min + 199 * scan.angle_increment;
+    scan.range_min = 0.02;
+    scan.range_max = 5.6;
+    scan.ranges.assign(200, 3.0);
+    scan.ranges[150] = 10.0;                              // no return
+
+    ScanGeometry scan_geometry;
+    CartesianScan cartesian_scan;
+    scan_geometry.toCartesian(scan, cartesian_scan);
+
+    ScanMask mask;
+    mask.setLearningParameters(0.1, 3);
+    ScanProcessor processor;
+
+    // the background is only used after the minimum number of scans
+    for (int n = 0; n < 3; ++n)
+    {
+        processor.setScan(scan, cartesian_scan, mask);
+        EXPECT_EQ(199u, processor.getClusters().front().size());
+        mask.addScan(scan, cartesian_scan);
+    }
+    ASSERT_TRUE(mask.isActive());
+
+    // a leg in front of the wall and an object on the beam without return remain
+    for (int i = 100; i < 110; ++i)
+        scan.ranges[i] = 1.5;
+    scan.ranges[150] = 4.0;
+    scan_geometry.toCartesian(scan, cartesian_scan);
+
+    processor.setScan(scan, cartesian_scan, mask);
+    const SampleSet& samples = processor.getClusters().front();
+    ASSERT_EQ(11u, samples.size());
+    EXPECT_EQ(100, samples.front().index);
+    EXPECT_EQ(150, samples.back().index);
+
+    // the background recedes towards the new ranges with the decay
+    mask.addScan(scan, cartesian_scan);
+    EXPECT_FALSE(mask.hasBeam(100, 1.5, 0.03));
+    EXPECT_TRUE(mask.hasBeam(100, 3.0, 0.03));
+    EXPECT_FALSE(mask.hasBeam(150, 4.0, 0.03));
+
+    mask.clear();
+    EXPECT_FALSE(mask.isActive());
+}
+
+TEST(laser_processor_test, mask_skips_excluded_beams)
+{
+    sensor_msgs::LaserScan scan;
+    scan.angle_min = -1.0;
+    scan.angle_increment = 0.01;
+    scan.angle_max = scan.angle_min + 199 * scan.angle_increment;
+    scan.range_min = 0.02;
+    scan.range_max = 5.6;
+    scan.ranges.assign(200, 3.0);
+
+    ScanGeometry scan_geometry;
+    CartesianScan cartesian_scan;
+    scan_geometry.toCartesian(scan, cartesian_scan);
+
+    ScanMask mask;
+    mask.setLearningParameters(1.0, 1);
+    mask.addScan(scan, cartesian_scan);
+
+    // a person stands still in front of the wall, the beams of the person are excluded
+    for (int i = 100; i < 110; ++i)
+        scan.ranges[i] = 1.5;
+    scan_geometry.toCartesian(scan, cartesian_scan);
+
+    std::vector<BeamWindow> excluded;
+    excluded.push_back(BeamWindow(98, 112));
+    for (int n = 0; n < 100; ++n)
+        mask.addScan(scan, cartesian_scan, excluded);
+
+    EXPECT_FALSE(mask.hasBeam(105, 1.5, 0.03));
+    EXPECT_TRUE(mask.hasBeam(90, 3.0, 0.03));
+
+    // without the exclusion the person becomes background
+    mask.addScan(scan, cartesian_scan);
+    EXPECT_TRUE(mask.hasBeam(105, 1.5, 0.03));
+}
+
+TEST(laser_processor_test, beam_windows_select_samples)
+{
+    std::vector<BeamWindow> windows;
+    windows.push_back(BeamWindow(120, 180));
+    windows.push_back(BeamWindow(10, 20));
+    windows.push_back(BeamWindow(170, 190));
+    windows.push_back(BeamWindow(20, 25));
+    windows.push_back(BeamWindow(50, 50));
+    windows.push_back(BeamWindow(195, 260));
+    mergeBeamWindows(windows);
+
+    ASSERT_EQ(3u, windows.size());
+    EXPECT_EQ(BeamWindow(10, 25), windows[0]);
+    EXPECT_EQ(BeamWindow(120, 190), windows[1]);
+    EXPECT_EQ(BeamWindow(195, 260), windows[2]);
+
+    Random random(7);
+    sensor_msgs::LaserScan scan = simulateScan(random);
+    ASSERT_LT(200u, scan.ranges.size());
+
+    ScanGeometry scan_geometry;
+    CartesianScan cartesian_scan;
+    scan_geometry.toCartesian(scan, cartesian_scan);
+
+    ScanMask mask;
+    ScanProcessor processor;
+    processor.setScan(scan, cartesian_scan, mask);
+    std::vector<Sample> expected;
+    const SampleSet& all = processor.getClusters().front();
+    for (SampleSet::iterator s = all.begin(); s != all.end(); ++s)
+    {
+        for (size_t w = 0; w < windows.size(); ++w)
+            if (s->index >= static_cast<int>(windows[w].first) && s->index < static_cast<int>(windows[w].second))
+                expected.push_back(*s);
+    }
+
+    processor.setScan(scan, cartesian_scan, mask, windows);
+    const SampleSet& selected = processor.getClusters().front();
+    ASSERT_EQ(expected.size(), selected.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+        EXPECT_EQ(expected[i].index, selected.begin()[i].index);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2018 Bonn-Rhein-Sieg University
+ *
+ * Compares the association of TrackAssociation with an exhaustive search on small random scenes.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <vector>
+
+#include "mcr_leg_detection/track_association.h"
+
+using estimation::TrackAssociation;
+
+namespace
+{
+struct Score
+{
+    int num_assigned;
+    double cost;
+};
+
+// more assigned detections win, for the same number the lower cost wins
+bool isBetter(const Score& a, const Score& b)
+{
+    if (a.num_assigned != b.num_assigned)
+        return a.num_assigned > b.num_assigned;
+    return a.cost < b.cost - 1e-9;
+}
+
+Score score(const std::vector<tf::Point>& tracks, const std::vector<tf::Point>& detections,
+            const std::vector<int>& assignment)
+{
+    Score s = { 0, 0.0 };
+    for (size_t d = 0; d < assignment.size(); ++d)
+    {
+        if (assignment[d] >= 0)
+        {
+            s.num_assigned++;
+            s.cost += detections[d].distance(tracks[assignment[d]]);
+        }
+    }
+    return s;
+}
+
+void searchBest(const std::vector<tf::Point>& tracks, const std::vector<tf::Point>& detections, double gate,
+                size_t d, std::vector<int>& assignment, std::vector<bool>& used, Score& best)
+{
+    if (d == detections.size())
+    {
+        Score s = score(tracks, detections, assignment);
+        if (isBetter(s, best))
+            best = s;
+        return;
+    }
+
+    assignment[d] = -1;
+    searchBest(tracks, detections, gate, d + 1, assignment, used, best);
+
+    for (size_t t = 0; t < tracks.size(); ++t)
+    {
+        if (!used[t] && detections[d].distance(tracks[t]) < gate)
+        {
+            used[t] = true;
+            assignment[d] = t;
+            searchBest(tracks, detections, gate, d + 1, assignment, used, best);
+            used[t] = false;
+        }
+    }
+    assignment[d] = -1;
+}
+
+double uniform(double min, double max)
+{
+    return min + (max - min) * (rand() / (RAND_MAX + 1.0));
+}
+}  // namespace
+
+TEST(track_association_test, matches_exhaustive_search)
+{
+    const double gate = 1.0;
+    TrackAssociation association(gate);
+    srand(42);
+
+    for (int n = 0; n < 500; ++n)
+    {
+        // crowded scenes, so that most scenes contain groups with several tracks
+        std::vector<tf::Point> tracks(rand() % 7);
+        std::vector<tf::Point> detections(rand() % 7);
+        for (size_t t = 0; t < tracks.size(); ++t)
+            tracks[t] = tf::Point(uniform(-2.0, 2.0), uniform(-2.0, 2.0), 0.0);
+        for (size_t d = 0; d < detections.size(); ++d)
+            detections[d] = tf::Point(uniform(-2.0, 2.0), uniform(-2.0, 2.0), 0.0);
+
+        std::vector<int> assignment;
+        association.associate(tracks, detections, assignment);
+        ASSERT_EQ(detections.size(), assignment.size());
+
+        // valid: every track at most once and only within the gate
+        std::vector<bool> used(tracks.size(), false);
+        for (size_t d = 0; d < assignment.size(); ++d)
+        {
+            if (assignment[d] < 0)
+                continue;
+            ASSERT_LT(assignment[d], static_cast<int>(tracks.size()));
+            ASSERT_FALSE(used[assignment[d]]) << "scene " << n;
+            used[assignment[d]] = true;
+            EXPECT_LT(detections[d].distance(tracks[assignment[d]]), gate);
+        }
+
+        // optimal
+        Score best = { -1, 0.0 };
+        std::vector<int> search_assignment(detections.size(), -1);
+        std::vector<bool> search_used(tracks.size(), false);
+        searchBest(tracks, detections, gate, 0, search_assignment, search_used, best);
+
+        Score actual = score(tracks, detections, assignment);
+        EXPECT_EQ(best.num_assigned, actual.num_assigned) << "scene " << n;
+        EXPECT_NEAR(best.cost, actual.cost, 1e-9) << "scene " << n;
+    }
+}
+
+TEST(track_association_test, ignores_far_tracks)
+{
+    TrackAssociation association(1.0);
+
+    std::vector<tf::Point> tracks;
+    tracks.push_back(tf::Point(0.0, 0.0, 0.0));
+    tracks.push_back(tf::Point(10.0, -3.0, 0.0));
+
+    std::vector<tf::Point> detections;
+    detections.push_back(tf::Point(10.5, -3.2, 0.0));
+    detections.push_back(tf::Point(5.0, 5.0, 0.0));
+    detections.push_back(tf::Point(-0.9, -0.1, 0.0));
+
+    std::vector<int> assignment;
+    association.associate(tracks, detections, assignment);
+
+    ASSERT_EQ(3u, assignment.size());
+    EXPECT_EQ(1, assignment[0]);
+    EXPECT_EQ(-1, assignment[1]);
+    EXPECT_EQ(0, assignment[2]);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -8,6 +8,13 @@ class ScanItem
 {
 public:
     ScanItem()
+        : angle(0), distance(0), cartesian_angle(0), cartesian_distance(0), cartesian_x(0), cartesian_y(0)
+    {
+    }
+    /* x and y have to be the cartesian coordinates of angle and distance, e.g. from a cached ScanGeometry */
+    ScanItem(double angle, double distance, double x, double y)
+        : angle(angle), distance(distance), cartesian_angle(angle), cartesian_distance(distance), cartesian_x(x),
+          cartesian_y(y)
     {
     }
     virtual ~ScanItem()
@@ -19,13 +26,33 @@ public:
 
     double x()
     {
-        return distance * cos(angle);
+        updateCartesian();
+        return cartesian_x;
     }
 
     double y()
     {
-        return distance * sin(angle);
+        updateCartesian();
+        return cartesian_y;
+    }
+
+private:
+    /* the cartesian coordinates are only recomputed when angle or distance were changed */
+    void updateCartesian()
+    {
+        if (angle != cartesian_angle || distance != cartesian_distance)
+        {
+            cartesian_angle = angle;
+            cartesian_distance = distance;
+            cartesian_x = distance * cos(angle);
+            cartesian_y = distance * sin(angle);
+        }
     }
+
+    double cartesian_angle;
+    double cartesian_distance;
+    double cartesian_x;
+    double cartesian_y;
 };
 
 class ScanItemFilter
@@ -11,15 +11,21 @@
 #include <vector>
 
 #include <sensor_msgs/LaserScan.h>
+#include <mcr_scan_geometry/scan_geometry.h>
 #include "mcr_linear_regression/laser_scan_linear_regression.h"
 
 class LaserScanLinearRegressionUtil
 {
 public:
-    LaserScanLinearRegressionUtil();
+    /* angle_offset in radians, added to the angle of each beam */
+    explicit LaserScanLinearRegressionUtil(double angle_offset = 0.0);
     virtual ~LaserScanLinearRegressionUtil();
 
-    std::vector<LaserScanLinearRegression::ScanItem> convert(sensor_msgs::LaserScanConstPtr scan, double angle_offset);
+    std::vector<LaserScanLinearRegression::ScanItem> convert(sensor_msgs::LaserScanConstPtr scan);
+
+private:
+    ScanGeometry scan_geometry_;
+    CartesianScan cartesian_scan_;
 
 };
 
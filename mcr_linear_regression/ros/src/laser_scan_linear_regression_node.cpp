@@ -23,7 +23,9 @@ protected:
     LaserScanLinearRegressionUtil util;
 public:
 
+    //FIXME: check if the angle object is youBot/hokoyu dependend
     LaserScanLinearRegressionService(ros::NodeHandle nh, std::string basescan_topic)
+        : util(-0.025)
     {
         this->nh = nh;
         this->basescan_topic = basescan_topic;
@@ -45,9 +47,6 @@ public:
             req.filter_maxDistance = 0.8;
         }
 
-        //FIXME: check if the angle object is youBot/hokoyu dependend
-        double angle_offset = -0.025;
-
         ROS_DEBUG("Wait for base_scan message");
 
         double sum_center = 0.0;
@@ -66,7 +65,7 @@ public:
                 return false;
             }
 
-            std::vector<LaserScanLinearRegression::ScanItem> data = util.convert(scan, angle_offset);
+            std::vector<LaserScanLinearRegression::ScanItem> data = util.convert(scan);
 
             std::vector<LaserScanLinearRegression::ScanItem> filtered_data = scanfilter.filterByDistance(data, req.filter_minDistance, req.filter_maxDistance);
             filtered_data = scanfilter.filterByAngle(filtered_data, req.filter_minAngle, req.filter_maxAngle);
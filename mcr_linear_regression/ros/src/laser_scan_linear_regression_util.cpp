@@ -1,6 +1,7 @@
 #include "mcr_linear_regression/laser_scan_linear_regression_util.h"
 
-LaserScanLinearRegressionUtil::LaserScanLinearRegressionUtil()
+LaserScanLinearRegressionUtil::LaserScanLinearRegressionUtil(double angle_offset)
+    : scan_geometry_(angle_offset)
 {
 
 }
@@ -10,7 +11,7 @@ LaserScanLinearRegressionUtil::~LaserScanLinearRegressionUtil()
 
 }
 
-std::vector<LaserScanLinearRegression::ScanItem> LaserScanLinearRegressionUtil::convert(sensor_msgs::LaserScanConstPtr scan, double angle_offset)
+std::vector<LaserScanLinearRegression::ScanItem> LaserScanLinearRegressionUtil::convert(sensor_msgs::LaserScanConstPtr scan)
 {
     std::vector<LaserScanLinearRegression::ScanItem> data;
 
@@ -19,12 +20,13 @@ std::vector<LaserScanLinearRegression::ScanItem> LaserScanLinearRegressionUtil::
         return data;
     }
 
-    LaserScanLinearRegression::ScanItem tmpItem;
-    for (unsigned int i = 0; i < scan->ranges.size(); i++)
+    scan_geometry_.toCartesian(*scan, cartesian_scan_);
+
+    data.reserve(cartesian_scan_.size());
+    for (unsigned int i = 0; i < cartesian_scan_.size(); i++)
     {
-        tmpItem.angle = angle_offset + scan->angle_min + scan->angle_increment * i;
-        tmpItem.distance = scan->ranges[i];
-        data.push_back(tmpItem);
+        data.push_back(LaserScanLinearRegression::ScanItem(scan_geometry_.getAngle(i), cartesian_scan_.range[i],
+                                                           cartesian_scan_.x[i], cartesian_scan_.y[i]));
     }
 
     return data;
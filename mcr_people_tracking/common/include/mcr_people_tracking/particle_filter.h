@@ -25,60 +25,115 @@
 
 #define OBSERV_STD      0.3
 
+/* particles are only scored against segments in the grid cells around them, the cells have this size in meters */
+#define OBSERV_GATE     1.0
+
+/* KLD-sampling: bound of the KL divergence, upper standard normal quantile of 1 - delta and the bin size in meters.
+ * A bin spans about two standard deviations of the spread the transition noise adds between two updates (0.15 m),
+ * or three of the observation noise, so a tracked person occupies a handful of bins instead of a new one for every
+ * tenth of the particles */
+#define KLD_EPSILON     0.1
+#define KLD_Z           2.326
+#define KLD_BIN_SIZE    0.3
+
 /* autoregressive dynamics parameters for transition model */
 #define PARAM_A1  2.0//2.0
 #define PARAM_A2  -1.0//-1.0
 #define PARAM_B0  1.0//1.0000
 
+#include <algorithm>
 #include <iostream>
 #include <math.h>
 #include <stdlib.h>
 #include <vector>
 
-#include <boost/random.hpp>
+#include <stdint.h>
 #include <time.h>
 
 #include <mcr_perception_msgs/LaserScanSegmentList.h>
 #include <mcr_perception_msgs/LaserScanSegment.h>
 
+#include "mcr_people_tracking/random_generator.h"
+
 using namespace std;
 
-struct StrParticle
+/*
+ * all particles of a filter in structure-of-arrays layout, entry i of every array belongs to particle i
+ */
+struct StrParticleSet
 {
-    StrParticle()
-        : dX(0),
-          dY(0),
-          dPrevX(0),
-          dPrevY(0),
-          dOrgX(0),
-          dOrgY(0),
-          dWeight(0),
-          iCorrespondToObj(-1)
+    vector<double> vecX;                // current x coordinate of the COG
+    vector<double> vecY;                // current y coordinate of the COG
+    vector<double> vecVx;               // current velocity in x direction of the COG
+    vector<double> vecVy;               // current velocity in y direction of the COG
+    vector<double> vecPrevX;            // previous x coordinate of the COG
+    vector<double> vecPrevY;            // previous y coordinate of the COG
+    vector<double> vecOrgX;             // original x coordinate of the COG
+    vector<double> vecOrgY;             // original y coordinate of the COG
+    vector<double> vecWeight;           // weight
+    vector<int> vecCorrespondToObj;     // determines to which object a particle belongs
+
+    void reserve(unsigned int unCapacity)
     {
+        vecX.reserve(unCapacity);
+        vecY.reserve(unCapacity);
+        vecVx.reserve(unCapacity);
+        vecVy.reserve(unCapacity);
+        vecPrevX.reserve(unCapacity);
+        vecPrevY.reserve(unCapacity);
+        vecOrgX.reserve(unCapacity);
+        vecOrgY.reserve(unCapacity);
+        vecWeight.reserve(unCapacity);
+        vecCorrespondToObj.reserve(unCapacity);
+    }
+
+    void resize(unsigned int unSize)
+    {
+        vecX.resize(unSize);
+        vecY.resize(unSize);
+        vecVx.resize(unSize);
+        vecVy.resize(unSize);
+        vecPrevX.resize(unSize);
+        vecPrevY.resize(unSize);
+        vecOrgX.resize(unSize);
+        vecOrgY.resize(unSize);
+        vecWeight.resize(unSize);
+        vecCorrespondToObj.resize(unSize);
     }
-    ;
 
-    double dX;              // current x coordinate of the COG
-    double dY;              // current x coordinate of the COG
-    double dVx;             // current velocity in x direction of the COG
-    double dVy;             // current velocity in y direction of the COG
-    double dPrevX;          // previous x coordinate of the COG
-    double dPrevY;          // previous y coordinate of the COG
-    double dPrevVx;         // previous velocity in x direction of the COG
-    double dPrevVy;         // previous velocity in y direction of the COG
-    double dOrgX;           // original x coordinate of the COG
-    double dOrgY;           // original x coordinate of the COG
-    double dOrgVx;          // original velocity in x direction of the COG
-    double dOrgVy;          // original velocity in y direction of the COG
-    double dWeight;         // weight
-    int iCorrespondToObj;   // determines to which object this particle belongs
-    long double ldTimestep;  // time step between two state transitions
-
-    static bool SortByWeights(const StrParticle* particleA, const StrParticle* particleB)
+    unsigned int size() const
     {
-        return particleA->dWeight > particleB->dWeight;
+        return vecX.size();
     }
 
+    void swap(StrParticleSet &strOther)
+    {
+        vecX.swap(strOther.vecX);
+        vecY.swap(strOther.vecY);
+        vecVx.swap(strOther.vecVx);
+        vecVy.swap(strOther.vecVy);
+        vecPrevX.swap(strOther.vecPrevX);
+        vecPrevY.swap(strOther.vecPrevY);
+        vecOrgX.swap(strOther.vecOrgX);
+        vecOrgY.swap(strOther.vecOrgY);
+        vecWeight.swap(strOther.vecWeight);
+        vecCorrespondToObj.swap(strOther.vecCorrespondToObj);
+    }
+
+    /* copies particle unFrom of strOther to particle unTo of this set */
+    void copyParticle(unsigned int unTo, const StrParticleSet &strOther, unsigned int unFrom)
+    {
+        vecX[unTo] = strOther.vecX[unFrom];
+        vecY[unTo] = strOther.vecY[unFrom];
+        vecVx[unTo] = strOther.vecVx[unFrom];
+        vecVy[unTo] = strOther.vecVy[unFrom];
+        vecPrevX[unTo] = strOther.vecPrevX[unFrom];
+        vecPrevY[unTo] = strOther.vecPrevY[unFrom];
+        vecOrgX[unTo] = strOther.vecOrgX[unFrom];
+        vecOrgY[unTo] = strOther.vecOrgY[unFrom];
+        vecWeight[unTo] = strOther.vecWeight[unFrom];
+        vecCorrespondToObj[unTo] = strOther.vecCorrespondToObj[unFrom];
+    }
 };
 
 struct StrPoint
@@ -133,12 +188,12 @@ public:
      * establish an initial distribution of particles based on the first measurements
      *
      * @param vecMeasurements a vector of measurements
-     * @return returns 0 if the initialization was successful
+     * @return returns 0 if the initialization was successful, -1 if there are no measurements
      */
-    int initialize(mcr_perception_msgs::LaserScanSegmentList vecMeasurements);
+    int initialize(const mcr_perception_msgs::LaserScanSegmentList &vecMeasurements);
 
     /*
-     * perform the state transition for each particle in the particle set
+     * perform the state transition for each particle in the particle set, the weights are kept
      *
      * @return returns 0 if the prediction was successful
      */
@@ -150,41 +205,105 @@ public:
      * @param vecMeasurements a vector of measurements
      * @return returns 0 if the update was successful
      */
-    int update(mcr_perception_msgs::LaserScanSegmentList vecMeasurements);
+    int update(const mcr_perception_msgs::LaserScanSegmentList &vecMeasurements);
+
+    /*
+     * effective sample size 1 / sum(w^2) of the normalized weights, between 1 and the number of particles
+     */
+    double getEffectiveSampleSize() const;
+
+    /*
+     * restarts the random number generator with a fixed seed, the same seed and the same measurements always give
+     * the same estimates. By default every filter is seeded from the time.
+     */
+    void setSeed(uint64_t unSeed)
+    {
+        this->_randomGenerator.seed(unSeed);
+    }
+
+    /*
+     * the particles are resampled when the effective sample size drops below dFraction times the number of
+     * particles, 1.0 resamples on every update
+     */
+    void setResamplingThreshold(double dFraction)
+    {
+        this->_dResamplingThreshold = dFraction;
+    }
+
+    /*
+     * lets the number of particles adapt between the limits with KLD-sampling, the filter starts with the number
+     * of particles given to the constructor, clamped to the limits. Equal limits keep the number fixed.
+     */
+    void setParticleLimits(unsigned int unMinParticles, unsigned int unMaxParticles);
 
     /*
      * get the current particles
      *
      * @return returns the complete set of particles
      */
-    vector<StrParticle*> getParticles()
+    const StrParticleSet& getParticles() const
     {
-        return this->_vecParticleSet;
+        return this->_strParticleSet;
     }
 
     void getPersonEstimates();
-    StrPoint* getMostLikelyParticle();
-    StrPoint* getMostLikelyPosition();
+
+    /*
+     * the estimates are computed once by every initialize, predict and update, reading them is free
+     *
+     * @return returns the particle with the largest weight of the last update
+     */
+    const StrPoint& getMostLikelyParticle() const
+    {
+        return this->_strMostLikelyParticle;
+    }
+
+    /*
+     * @return returns the weighted mean of all particles
+     */
+    const StrPoint& getMostLikelyPosition() const
+    {
+        return this->_strMostLikelyPosition;
+    }
+
     //strParticle* predictAndUpdate();
     //strParticle* update(){};
 
 private:
+    //returns summed particle weights (not normalized)
+    double oberservationLikelihood(const mcr_perception_msgs::LaserScanSegmentList &vecMeasurements);
+    int normalizeParticleWeights(double dSummedWeights);
+    int resampleParticles(unsigned int unNewSize);
+
+    /*
+     * computes the cached weighted mean and most likely particle of the current particles
+     */
+    void updateEstimates();
+
+    /*
+     * the number of particles the KLD bound asks for, given the bins the current weighted particles occupy
+     */
+    unsigned int getKldParticleCount();
+
+    void resizeBuffers(unsigned int unSize);
+
     /*
-     * calculates the state transition for a given particle
+     * finds the closest segment of every particle and stores the exponent of its gaussian in _vecLikelihood
      *
-     * @param strParticle a single particle
-     *        ldTimestep time in milliseconds between two predictions
-     * @return returns 0 if the state transition was successful
+     * @param bGated only consider the segments in the grid cells around a particle
+     * @return returns the number of particles with a segment
      */
-    int stateTransition(StrParticle *strParticle);
+    unsigned int assignClosestSegments(const mcr_perception_msgs::LaserScanSegmentList &vecMeasurements, bool bGated);
 
-    //returns summed particle weights (not normalized)
-    double oberservationLikelihood(mcr_perception_msgs::LaserScanSegmentList vecMeasurements);
-    int normalizeParticleWeights(double dSummedWeights);
-    int resampleParticles();
+    /*
+     * precomputes the coefficients of the quadratic form in the exponent of a rotated 2D gaussian
+     */
+    void setGaussianCoefficients(double dXSigma, double dYSigma, double dTheta);
 
-    double getGaussian2D(double dXValue, double dYValue, double dXcenter, double dYCenter, double dXSigma, double dYSigma, double dTheta);
-    double getRandomNoise(double dDeviation);
+    /*
+     * fills the array with uniform noise in the range [-dDeviation / 2, dDeviation / 2]
+     */
+    void getRandomNoise(vector<double> &vecNoise, double dDeviation);
 
     //void normalize_weights( particle* particles, int n );
     //strParticles* resample( particle* particles, int n );
@@ -192,19 +311,62 @@ private:
     //void display_particle( IplImage* img, particle p, CvScalar color );
 
     /*
-     * holds the overall number of particles
+     * holds the initial number of particles and the limits of the adaptation
      */
     unsigned int _unNumberOfParticles;
+    unsigned int _unMinParticles;
+    unsigned int _unMaxParticles;
+
+    /*
+     * storage of all particles and the buffer the resampling writes to, both are swapped afterwards
+     */
+    StrParticleSet _strParticleSet;
+    StrParticleSet _strResampledParticleSet;
+
+    /*
+     * per particle scratch arrays, allocated once
+     */
+    vector<double> _vecNoiseX;
+    vector<double> _vecNoiseY;
+    vector<double> _vecLikelihood;
+    vector<double> _vecInGate;
+
+    /*
+     * the segment centers of an update, bucketed by their grid cell
+     */
+    vector<double> _vecSegmentX;
+    vector<double> _vecSegmentY;
+    vector<pair<int64_t, unsigned int> > _vecSegmentCells;
+    vector<unsigned int> _vecCandidateSegments;
+    vector<int64_t> _vecKldBins;
+
+    /*
+     * exponent of the observation gaussian: a * dx^2 + 2 * b * dx * dy + c * dy^2
+     */
+    double _dGaussA;
+    double _dGaussB;
+    double _dGaussC;
+
+    /*
+     * index of the particle with the largest weight after the last update
+     */
+    unsigned int _unMostLikelyIndex;
+
+    /*
+     * the estimates of the current particles
+     */
+    StrPoint _strMostLikelyPosition;
+    StrPoint _strMostLikelyParticle;
 
     /*
-     * storage of all particles
+     * resample when the effective sample size drops below this fraction of the particles
      */
-    vector<StrParticle*> _vecParticleSet;
+    double _dResamplingThreshold;
 
     /*
      * random number generator
      */
-    boost::mt19937 _pRandomNumberGenerator;
+    BlockRandomGenerator _randomGenerator;
 };
 
 #endif /* TRACKINGPARTICLEFILTER_H_ */
@@ -0,0 +1,163 @@
+/*
+ *  particle_filter_bank.h
+ *
+ *  One TrackingParticleFilter per tracked person, updated in parallel.
+ */
+
+#ifndef TRACKINGPARTICLEFILTERBANK_H_
+#define TRACKINGPARTICLEFILTERBANK_H_
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <mcr_perception_msgs/LaserScanSegmentList.h>
+#include <mcr_perception_msgs/LaserScanSegment.h>
+
+#include "mcr_people_tracking/particle_filter.h"
+
+class TrackingParticleFilterBank
+{
+public:
+    /*
+     * Constructor of TrackingParticleFilterBank
+     *
+     * @param unParticlesPerTarget the number of particles of the filter of each target
+     *        unNumberOfThreads the number of worker threads, 0 updates all filters in the calling thread
+     */
+    TrackingParticleFilterBank(unsigned int unParticlesPerTarget, unsigned int unNumberOfThreads);
+
+    /*
+     * Destructor of TrackingParticleFilterBank
+     *
+     * stops the worker threads
+     */
+    virtual ~TrackingParticleFilterBank();
+
+    /*
+     * starts tracking a new target at the segment
+     *
+     * @return returns the id of the target, ids are never reused
+     */
+    int addTarget(const mcr_perception_msgs::LaserScanSegment &segment);
+
+    /*
+     * stops tracking a target
+     *
+     * @return returns false if there is no target with this id
+     */
+    bool removeTarget(int iId);
+
+    /*
+     * removes all targets
+     */
+    void clear();
+
+    /*
+     * perform the state transition of all targets
+     */
+    void predict();
+
+    /*
+     * assigns every segment to the closest target within the gate distance and updates each target with its
+     * segments, a target without segments keeps its particles
+     *
+     * @param vecMeasurements a vector of measurements
+     *        vecUnassigned returns the segments which are not close to any target
+     */
+    void update(const mcr_perception_msgs::LaserScanSegmentList &vecMeasurements,
+                mcr_perception_msgs::LaserScanSegmentList &vecUnassigned);
+
+    /*
+     * segments further than dDistance in meters from the position of a target are never assigned to it
+     */
+    void setGateDistance(double dDistance)
+    {
+        this->_dGateDistance = dDistance;
+    }
+
+    /*
+     * limits of the adaptive number of particles of every target, see TrackingParticleFilter::setParticleLimits
+     */
+    void setParticleLimits(unsigned int unMinParticles, unsigned int unMaxParticles);
+
+    /*
+     * seeds the filter of every target, existing and new ones, with unSeed plus the id of the target, so a run
+     * with the same seed and the same scans is reproducible
+     */
+    void setSeed(uint64_t unSeed);
+
+    unsigned int size() const
+    {
+        return this->_vecTargets.size();
+    }
+
+    /*
+     * @return returns the ids of all targets
+     */
+    vector<int> getTargetIds() const;
+
+    /*
+     * @return returns the filter of the target, NULL if there is no target with this id
+     */
+    const TrackingParticleFilter* getTarget(int iId) const;
+
+    /*
+     * @return returns the number of updates since the target had a segment in its gate
+     */
+    unsigned int getMissedUpdates(int iId) const;
+
+private:
+    struct StrTarget
+    {
+        int iId;
+        boost::shared_ptr<TrackingParticleFilter> pFilter;
+        mcr_perception_msgs::LaserScanSegmentList vecSegments;  // the segments assigned in the current update
+        unsigned int unMissedUpdates;
+    };
+
+    enum EnJob
+    {
+        JOB_PREDICT,
+        JOB_UPDATE
+    };
+
+    int findTarget(int iId) const;
+
+    /*
+     * runs the job for every target, on the worker threads and the calling thread
+     */
+    void runForAllTargets(EnJob enJob);
+    void runJobs();
+    void runJob(unsigned int unTarget);
+    void workerLoop();
+
+    unsigned int _unParticlesPerTarget;
+    unsigned int _unMinParticles;
+    unsigned int _unMaxParticles;
+    bool _bFixedSeed;
+    uint64_t _unSeed;
+    double _dGateDistance;
+    int _iNextId;
+    vector<StrTarget> _vecTargets;
+    vector<StrPoint> _vecPositions;
+
+    /*
+     * worker threads, they take the targets of a job one by one until all are done
+     */
+    boost::thread_group _threads;
+    boost::mutex _mutex;
+    boost::condition_variable _condWork;
+    boost::condition_variable _condDone;
+    EnJob _enJob;
+    unsigned int _unNextJob;
+    unsigned int _unNumberOfJobs;
+    unsigned int _unPendingJobs;
+    unsigned int _unGeneration;
+    bool _bShutdown;
+};
+
+#endif /* TRACKINGPARTICLEFILTERBANK_H_ */
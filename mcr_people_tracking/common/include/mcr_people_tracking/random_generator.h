@@ -0,0 +1,66 @@
+/*
+ *  random_generator.h
+ *
+ *  xoshiro256+ generator which produces uniform random numbers in blocks.
+ */
+
+#ifndef BLOCKRANDOMGENERATOR_H_
+#define BLOCKRANDOMGENERATOR_H_
+
+/* number of independent generator streams, one block holds one number of every stream */
+#define RANDOM_LANES 8
+
+#include <stdint.h>
+
+class BlockRandomGenerator
+{
+public:
+    /*
+     * Constructor of BlockRandomGenerator
+     *
+     * @param unSeed the same seed always gives the same sequence of numbers
+     */
+    BlockRandomGenerator(uint64_t unSeed = 0);
+
+    /*
+     * restarts the sequence, all streams are derived from the seed with splitmix64
+     */
+    void seed(uint64_t unSeed);
+
+    /*
+     * fills the array with uniformly distributed numbers, the streams are advanced side by side so the compiler
+     * can keep them in vector registers
+     *
+     * @param pdValues the array to fill
+     *        unSize number of values
+     *        dMin, dMax the range of the values
+     */
+    void fillUniform(double *pdValues, unsigned int unSize, double dMin, double dMax);
+
+    /*
+     * @return returns a single uniformly distributed number in the range [dMin, dMax)
+     */
+    double getUniform(double dMin, double dMax);
+
+private:
+    /*
+     * advances every stream once and writes one number in [1, 2) per stream
+     */
+    void generateBlock(double *pdValues);
+
+    /*
+     * the four state words of every stream, word-major so the lanes are contiguous
+     */
+    uint64_t _unState0[RANDOM_LANES];
+    uint64_t _unState1[RANDOM_LANES];
+    uint64_t _unState2[RANDOM_LANES];
+    uint64_t _unState3[RANDOM_LANES];
+
+    /*
+     * numbers of the last block which were not handed out yet
+     */
+    double _dBuffer[RANDOM_LANES];
+    unsigned int _unBufferPosition;
+};
+
+#endif /* BLOCKRANDOMGENERATOR_H_ */
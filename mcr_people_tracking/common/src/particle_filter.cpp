@@ -7,190 +7,358 @@
 
 #include "mcr_people_tracking/particle_filter.h"
 
+#include <string.h>
+
+namespace
+{
+/*
+ * exp(x) for -708 <= x <= 0 without branches, so loops over arrays vectorize. The argument is reduced to
+ * x = k * ln(2) + r with |r| <= ln(2) / 2, exp(r) is a polynomial and 2^k is written into the exponent bits.
+ * The relative error is below 1e-14.
+ */
+inline double negativeExp(double dX)
+{
+    const double dRoundingMagic = 6755399441055744.0;  // 1.5 * 2^52, rounds to the nearest integer when added
+    double dShifted = dX * 1.4426950408889634 + dRoundingMagic;
+    double dK = dShifted - dRoundingMagic;
+    double dR = (dX - dK * 6.93145751953125e-1) - dK * 1.42860682030941723212e-6;
+
+    double dPolynomial = 1.0 + dR * (1.0 + dR * (1.0 / 2 + dR * (1.0 / 6 + dR * (1.0 / 24 + dR * (1.0 / 120
+                         + dR * (1.0 / 720 + dR * (1.0 / 5040 + dR * (1.0 / 40320 + dR * (1.0 / 362880
+                         + dR * (1.0 / 3628800 + dR * (1.0 / 39916800)))))))))));
+
+    // the low bits of dShifted hold k, the shift drops the others. Unsigned, since they do not fit in a signed shift.
+    uint64_t unShiftedBits;
+    memcpy(&unShiftedBits, &dShifted, sizeof(unShiftedBits));
+    uint64_t unScaleBits = (unShiftedBits + 1023) << 52;
+    double dScale;
+    memcpy(&dScale, &unScaleBits, sizeof(dScale));
+
+    return dPolynomial * dScale;
+}
+
+inline int64_t getCellKey(int iCellX, int iCellY)
+{
+    // the same bits as shifting iCellX up, which is undefined for negative cells
+    return static_cast<int64_t>(iCellX) * (static_cast<int64_t>(1) << 32) + static_cast<uint32_t>(iCellY);
+}
+
+inline int getCellIndex(double dCoordinate, double dCellSize = OBSERV_GATE)
+{
+    return static_cast<int>(floor(dCoordinate / dCellSize));
+}
+
+inline void setPlanarPoint(StrPoint &strPoint, double dX, double dY)
+{
+    strPoint.dX = dX;
+    strPoint.dY = dY;
+    strPoint.dZ = 0;
+    strPoint.dDistance = sqrt(pow(dX, 2) + pow(dY, 2));
+    strPoint.dRoll = 0;
+    strPoint.dPitch = 0;
+    strPoint.dYaw = atan(dY / dX);
+}
+}
+
 TrackingParticleFilter::TrackingParticleFilter(unsigned int unNumberOfParticles)
 {
     this->_unNumberOfParticles = unNumberOfParticles;
 
-    _pRandomNumberGenerator.seed(time(0));
+    // all per particle storage is allocated up front, the filter steps only reuse it
+    this->setParticleLimits(unNumberOfParticles, unNumberOfParticles);
+
+    this->setGaussianCoefficients(SYSTEM_X_STD, SYSTEM_Y_STD, 0.0);
+
+    this->_unMostLikelyIndex = 0;
+    this->_dResamplingThreshold = 0.5;
+
+    // filters created in the same second still get different streams
+    this->_randomGenerator.seed(static_cast<uint64_t>(time(0)) ^ reinterpret_cast<uintptr_t>(this));
 }
 
 TrackingParticleFilter::~TrackingParticleFilter()
 {
-    for (unsigned int i = 0; i < this->_vecParticleSet.size(); ++i)
-        free(this->_vecParticleSet.at(i));
 }
 
-double TrackingParticleFilter::getRandomNoise(double dDeviation)
+void TrackingParticleFilter::setParticleLimits(unsigned int unMinParticles, unsigned int unMaxParticles)
 {
-    dDeviation /= 2;
+    this->_unMinParticles = max(1u, min(unMinParticles, unMaxParticles));
+    this->_unMaxParticles = max(this->_unMinParticles, unMaxParticles);
+
+    this->_strParticleSet.reserve(this->_unMaxParticles);
+    this->_strResampledParticleSet.reserve(this->_unMaxParticles);
+    this->_vecNoiseX.reserve(this->_unMaxParticles);
+    this->_vecNoiseY.reserve(this->_unMaxParticles);
+    this->_vecLikelihood.reserve(this->_unMaxParticles);
+    this->_vecInGate.reserve(this->_unMaxParticles);
+    this->_vecKldBins.reserve(this->_unMaxParticles);
+}
 
-    boost::uniform_real<> gm(-dDeviation, dDeviation);
-    boost::variate_generator<boost::mt19937&, boost::uniform_real<> > generate(_pRandomNumberGenerator, gm);
+void TrackingParticleFilter::resizeBuffers(unsigned int unSize)
+{
+    this->_vecNoiseX.resize(unSize);
+    this->_vecNoiseY.resize(unSize);
+    this->_vecLikelihood.resize(unSize);
+    this->_vecInGate.resize(unSize);
+}
 
-    return generate();
+void TrackingParticleFilter::getRandomNoise(vector<double> &vecNoise, double dDeviation)
+{
+    dDeviation /= 2;
+
+    if (!vecNoise.empty())
+        this->_randomGenerator.fillUniform(&vecNoise[0], vecNoise.size(), -dDeviation, dDeviation);
 }
 
-int TrackingParticleFilter::initialize(mcr_perception_msgs::LaserScanSegmentList vecMeasurements)
+int TrackingParticleFilter::initialize(const mcr_perception_msgs::LaserScanSegmentList &vecMeasurements)
 {
-    unsigned int iPriorParticlesPerMeasurement = 0;
-    unsigned int i = 0, k = 0;
-    StrParticle *strParticle = NULL;
+    unsigned int unNumberOfMeasurements = vecMeasurements.segments.size();
+    StrParticleSet &strSet = this->_strParticleSet;
 
-    //clear particle vector
-    this->_vecParticleSet.clear();
+    if (unNumberOfMeasurements == 0)
+        return -1;
 
-    //initial number of particles per detected person
-    iPriorParticlesPerMeasurement = this->_unNumberOfParticles / vecMeasurements.segments.size();
+    unsigned int unSize = max(this->_unMinParticles, min(this->_unNumberOfParticles, this->_unMaxParticles));
+    strSet.resize(unSize);
+    this->resizeBuffers(unSize);
 
-    //distribute particles uniformly over all initial observations
-    for (i = 0, k = 0; i < vecMeasurements.segments.size(); ++i)
-    {
-        for (unsigned int j = 0; j < iPriorParticlesPerMeasurement; ++j, ++k)
-        {
-            strParticle = new StrParticle();
-            strParticle->dOrgX = strParticle->dPrevX = strParticle->dX = vecMeasurements.segments[i].center.x + this->getRandomNoise(INIT_X_STD);
-            strParticle->dOrgY = strParticle->dPrevY = strParticle->dY = vecMeasurements.segments[i].center.y + this->getRandomNoise(INIT_Y_STD);
-            strParticle->dOrgVx = strParticle->dPrevVx = strParticle->dVx = 0;
-            strParticle->dOrgVy = strParticle->dPrevVy = strParticle->dVx = 0;
-            strParticle->dWeight = 0;
-            strParticle->iCorrespondToObj = i;
-            strParticle->ldTimestep = 0;
-            this->_vecParticleSet.push_back(strParticle);
-        }
-    }
+    this->getRandomNoise(this->_vecNoiseX, INIT_X_STD);
+    this->getRandomNoise(this->_vecNoiseY, INIT_Y_STD);
 
-    //assign the remaining particles
-    for (i = 0; k < this->_unNumberOfParticles; ++k)
+    //distribute particles uniformly over all initial observations, the remaining ones go round-robin to the
+    //first observations
+    for (unsigned int k = 0; k < unSize; ++k)
     {
-        strParticle = new StrParticle();
-        strParticle->dOrgX = strParticle->dPrevX = strParticle->dX = vecMeasurements.segments[i].center.x + this->getRandomNoise(INIT_X_STD);
-        strParticle->dOrgY = strParticle->dPrevY = strParticle->dY = vecMeasurements.segments[i].center.y + this->getRandomNoise(INIT_Y_STD);
-        strParticle->dOrgVx = strParticle->dPrevVx = strParticle->dVx = 0;
-        strParticle->dOrgVy = strParticle->dPrevVy = strParticle->dVx = 0;
-        strParticle->dWeight = 0;
-        strParticle->iCorrespondToObj = i;
-        this->_vecParticleSet.push_back(strParticle);
-
-        ++k;
-        i = (i + 1) % this->_unNumberOfParticles;
-    }
+        const mcr_perception_msgs::LaserScanSegment &segment = vecMeasurements.segments[k % unNumberOfMeasurements];
 
-    return 0;
-}
+        strSet.vecOrgX[k] = strSet.vecPrevX[k] = strSet.vecX[k] = segment.center.x + this->_vecNoiseX[k];
+        strSet.vecOrgY[k] = strSet.vecPrevY[k] = strSet.vecY[k] = segment.center.y + this->_vecNoiseY[k];
+        strSet.vecVx[k] = strSet.vecVy[k] = 0;
+        strSet.vecWeight[k] = 1.0 / unSize;
+        strSet.vecCorrespondToObj[k] = k % unNumberOfMeasurements;
+    }
 
-int TrackingParticleFilter::predict()
-{
-    // performs the prediction for the complete particle set
-    for (unsigned int i = 0; i < this->_unNumberOfParticles; ++i)
-        this->stateTransition(this->_vecParticleSet.at(i));
+    this->_unMostLikelyIndex = 0;
+    this->updateEstimates();
 
     return 0;
 }
 
-int TrackingParticleFilter::stateTransition(StrParticle *strParticle)
+int TrackingParticleFilter::predict()
 {
-    double dNewX = 0, dNewY = 0;
-//  double dVx = 0, dVy = 0;
-//  const double dGamma = 0.6;
+    StrParticleSet &strSet = this->_strParticleSet;
+    unsigned int unSize = strSet.size();
 
-// sample new state using second-order autoregressive dynamics
-    dNewX = PARAM_A1 * (strParticle->dX - strParticle->dOrgX) + PARAM_A2 * (strParticle->dPrevX - strParticle->dOrgX)
-            + PARAM_B0 * this->getRandomNoise(TRANS_X_STD) + strParticle->dOrgX;
-    dNewY = PARAM_A1 * (strParticle->dY - strParticle->dOrgY) + PARAM_A2 * (strParticle->dPrevY - strParticle->dOrgY)
-            + PARAM_B0 * this->getRandomNoise(TRANS_Y_STD) + strParticle->dOrgY;
+    if (unSize == 0)
+        return 0;
 
-    // calculate velocities
-    //dVx = (dGamma * (strParticle->dPrevVx * ldTimestep)) + ((1.0 - dGamma) * (dNewX - strParticle->dX));
-    //dVy = (dGamma * (strParticle->dPrevVy * ldTimestep)) + ((1.0 - dGamma) * (dNewY - strParticle->dY));
+    // draw the noise of all particles first, so the state transition below is a plain loop over the arrays
+    this->getRandomNoise(this->_vecNoiseX, TRANS_X_STD);
+    this->getRandomNoise(this->_vecNoiseY, TRANS_Y_STD);
 
-    //dNewX += dVx;
-    //dNewY += dVy;
+    double *pdX = &strSet.vecX[0], *pdY = &strSet.vecY[0];
+    double *pdPrevX = &strSet.vecPrevX[0], *pdPrevY = &strSet.vecPrevY[0];
+    const double *pdOrgX = &strSet.vecOrgX[0], *pdOrgY = &strSet.vecOrgY[0];
+    const double *pdNoiseX = &this->_vecNoiseX[0], *pdNoiseY = &this->_vecNoiseY[0];
 
-    strParticle->dPrevX = strParticle->dX;
-    strParticle->dPrevY = strParticle->dY;
-    strParticle->dX = dNewX;
-    strParticle->dY = dNewY;
-
-    strParticle->dPrevVx = strParticle->dVx;
-    strParticle->dPrevVy = strParticle->dVy;
-    //strParticle->dVx = (dVx / ldTimestep);
-    //strParticle->dVy = (dVy / ldTimestep);
+    // sample new state using second-order autoregressive dynamics
+    for (unsigned int i = 0; i < unSize; ++i)
+    {
+        double dNewX = PARAM_A1 * (pdX[i] - pdOrgX[i]) + PARAM_A2 * (pdPrevX[i] - pdOrgX[i]) + PARAM_B0 * pdNoiseX[i] + pdOrgX[i];
+        double dNewY = PARAM_A1 * (pdY[i] - pdOrgY[i]) + PARAM_A2 * (pdPrevY[i] - pdOrgY[i]) + PARAM_B0 * pdNoiseY[i] + pdOrgY[i];
 
-    //cout << "vx: " << strParticle->dVx << " vy: " << strParticle->dVy << endl;
+        pdPrevX[i] = pdX[i];
+        pdPrevY[i] = pdY[i];
+        pdX[i] = dNewX;
+        pdY[i] = dNewY;
+    }
 
-    strParticle->dWeight = 0;
+    this->updateEstimates();
 
     return 0;
 }
 
-int TrackingParticleFilter::update(mcr_perception_msgs::LaserScanSegmentList vecMeasurements)
+int TrackingParticleFilter::update(const mcr_perception_msgs::LaserScanSegmentList &vecMeasurements)
 {
+    StrParticleSet &strSet = this->_strParticleSet;
+    unsigned int unSize = strSet.size();
     double dSummedWeights = 0;
 
+    if (unSize == 0)
+        return 0;
+
     dSummedWeights = this->oberservationLikelihood(vecMeasurements);
 
     if (dSummedWeights > 0)
     {
         this->normalizeParticleWeights(dSummedWeights);
         //this->getPersonEstimates();
-        this->resampleParticles();
+
+        this->_unMostLikelyIndex = max_element(strSet.vecWeight.begin(), strSet.vecWeight.end()) - strSet.vecWeight.begin();
+
+        // resample only when the weights degenerated, every resampling adds sampling noise. The set is also
+        // resampled when the KLD bound asks for more particles or for less than half of them, or when the limits
+        // changed.
+        unsigned int unRequiredSize = this->_unMaxParticles;
+        if (this->_unMinParticles < this->_unMaxParticles)
+            unRequiredSize = this->getKldParticleCount();
+
+        if (this->getEffectiveSampleSize() < this->_dResamplingThreshold * unSize || unRequiredSize > unSize
+                || 2 * unRequiredSize < unSize || unSize > this->_unMaxParticles)
+            this->resampleParticles(unRequiredSize);
+    }
+    else
+    {
+        // no particle explains the measurements, start over with uniform weights
+        for (unsigned int i = 0; i < unSize; ++i)
+            strSet.vecWeight[i] = 1.0 / unSize;
     }
 
+    this->updateEstimates();
+
     return 0;
 }
 
-double TrackingParticleFilter::oberservationLikelihood(mcr_perception_msgs::LaserScanSegmentList vecMeasurements)
+double TrackingParticleFilter::getEffectiveSampleSize() const
+{
+    const StrParticleSet &strSet = this->_strParticleSet;
+    double dSquaredWeights = 0;
+
+    for (unsigned int i = 0; i < strSet.size(); ++i)
+        dSquaredWeights += strSet.vecWeight[i] * strSet.vecWeight[i];
+
+    return (dSquaredWeights > 0) ? 1.0 / dSquaredWeights : 0.0;
+}
+
+double TrackingParticleFilter::oberservationLikelihood(const mcr_perception_msgs::LaserScanSegmentList &vecMeasurements)
 {
-    //double* dObservLikelihood = new double[this->_unNumberOfParticles];
-    double dSummedDistances = 0;
-    double dMaxParticleLikelihood = 0;
-    double dParticleLikelihood = 0;
-//  double dEuclDist = 0;
-
-    // calculate distances between particle locations and measurements
-    for (unsigned int i = 0; i < this->_unNumberOfParticles; ++i)
+    StrParticleSet &strSet = this->_strParticleSet;
+    unsigned int unSize = strSet.size();
+    unsigned int unNumberOfSegments = vecMeasurements.segments.size();
+    double dSummedWeights = 0;
+
+    // bucket the segment centers on a grid, a particle only looks at the cells around its own one
+    this->_vecSegmentX.resize(unNumberOfSegments);
+    this->_vecSegmentY.resize(unNumberOfSegments);
+    this->_vecSegmentCells.clear();
+    for (unsigned int j = 0; j < unNumberOfSegments; ++j)
     {
-        for (unsigned int j = 0; j < vecMeasurements.segments.size(); ++j)
-        {
-            dParticleLikelihood = this->getGaussian2D(vecMeasurements.segments[j].center.x, vecMeasurements.segments[j].center.y,
-                                  this->_vecParticleSet.at(i)->dX, this->_vecParticleSet.at(i)->dY, SYSTEM_X_STD, SYSTEM_Y_STD, 0.0);
+        this->_vecSegmentX[j] = vecMeasurements.segments[j].center.x;
+        this->_vecSegmentY[j] = vecMeasurements.segments[j].center.y;
+        this->_vecSegmentCells.push_back(make_pair(getCellKey(getCellIndex(this->_vecSegmentX[j]), getCellIndex(this->_vecSegmentY[j])), j));
+    }
+    sort(this->_vecSegmentCells.begin(), this->_vecSegmentCells.end());
 
-            //dEuclDist = getEuclideanDistance2D(vecMeasurements.at(j)->strCenterPoint.dX, vecMeasurements.at(j)->strCenterPoint.dY,
-            //                              this->_vecParticleSet.at(i)->dX, this->_vecParticleSet.at(i)->dY);
+    // the grid only pays off with clutter. If the whole particle cloud lost the target, all segments are scored, so
+    // the weights still lead back to it.
+    if (unNumberOfSegments <= 4 || this->assignClosestSegments(vecMeasurements, true) == 0)
+        this->assignClosestSegments(vecMeasurements, false);
 
-            //dParticleLikelihood = (1.0 / (OBSERV_STD * sqrt(2 * M_PI))) * exp( (-pow(dEuclDist, 2.0)) / (2.0 * pow(OBSERV_STD, 2.0)) );
+    double *pdWeight = &strSet.vecWeight[0];
+    double *pdLikelihood = &this->_vecLikelihood[0];
+    const double *pdInGate = &this->_vecInGate[0];
 
-            // only take the closest measurement
-            if (dParticleLikelihood >= dMaxParticleLikelihood)
-            {
-                dMaxParticleLikelihood = dParticleLikelihood;
-                //  dObservLikelihood[i] = dParticleLikelihood;
-                this->_vecParticleSet.at(i)->iCorrespondToObj = j;
+    for (unsigned int i = 0; i < unSize; ++i)
+        pdLikelihood[i] = negativeExp(pdLikelihood[i]) * pdInGate[i];
+
+    // the weights are carried over from the last update until the next resampling
+    for (unsigned int i = 0; i < unSize; ++i)
+    {
+        pdWeight[i] *= pdLikelihood[i];
+        dSummedWeights += pdWeight[i];
+    }
 
+    return dSummedWeights;
+}
+
+unsigned int TrackingParticleFilter::assignClosestSegments(const mcr_perception_msgs::LaserScanSegmentList &vecMeasurements, bool bGated)
+{
+    StrParticleSet &strSet = this->_strParticleSet;
+    unsigned int unSize = strSet.size();
+    unsigned int unNumberOfSegments = vecMeasurements.segments.size();
+    unsigned int unInGate = 0;
+    int iLastCellX = 0, iLastCellY = 0;
+    bool bHasCandidates = false;
+
+    const double *pdX = &strSet.vecX[0], *pdY = &strSet.vecY[0];
+    int *piCorrespondToObj = &strSet.vecCorrespondToObj[0];
+    double *pdExponent = &this->_vecLikelihood[0];
+    double *pdInGate = &this->_vecInGate[0];
+
+    for (unsigned int i = 0; i < unSize; ++i)
+    {
+        // resampled particles are stored next to each other, so consecutive particles mostly share their cell
+        if (bGated)
+        {
+            int iCellX = getCellIndex(pdX[i]), iCellY = getCellIndex(pdY[i]);
+            if (!bHasCandidates || iCellX != iLastCellX || iCellY != iLastCellY)
+            {
+                this->_vecCandidateSegments.clear();
+                for (int iOffsetX = -1; iOffsetX <= 1; ++iOffsetX)
+                {
+                    for (int iOffsetY = -1; iOffsetY <= 1; ++iOffsetY)
+                    {
+                        int64_t iKey = getCellKey(iCellX + iOffsetX, iCellY + iOffsetY);
+                        vector<pair<int64_t, unsigned int> >::const_iterator it = lower_bound(this->_vecSegmentCells.begin(),
+                                this->_vecSegmentCells.end(), make_pair(iKey, 0u));
+                        for (; it != this->_vecSegmentCells.end() && it->first == iKey; ++it)
+                            this->_vecCandidateSegments.push_back(it->second);
+                    }
+                }
+
+                iLastCellX = iCellX;
+                iLastCellY = iCellY;
+                bHasCandidates = true;
             }
         }
 
-        dSummedDistances += dMaxParticleLikelihood;
+        unsigned int unNumberOfCandidates = bGated ? this->_vecCandidateSegments.size() : unNumberOfSegments;
+        double dMinExponent = HUGE_VAL;
+        int iClosest = -1;
+
+        // only take the closest measurement, on a tie the one with the higher index
+        for (unsigned int c = 0; c < unNumberOfCandidates; ++c)
+        {
+            unsigned int j = bGated ? this->_vecCandidateSegments[c] : c;
+            double dDiffX = this->_vecSegmentX[j] - pdX[i];
+            double dDiffY = this->_vecSegmentY[j] - pdY[i];
+            double dExponent = this->_dGaussA * dDiffX * dDiffX + 2 * this->_dGaussB * dDiffX * dDiffY + this->_dGaussC * dDiffY * dDiffY;
 
-        this->_vecParticleSet.at(i)->dWeight = dMaxParticleLikelihood;
+            if (dExponent < dMinExponent || (dExponent == dMinExponent && static_cast<int>(j) > iClosest))
+            {
+                dMinExponent = dExponent;
+                iClosest = j;
+            }
+        }
 
-        dMaxParticleLikelihood = 0;
+        if (iClosest >= 0)
+        {
+            piCorrespondToObj[i] = iClosest;
+            pdExponent[i] = -min(dMinExponent, 708.0);
+            pdInGate[i] = 1.0;
+            ++unInGate;
+        }
+        else
+        {
+            pdExponent[i] = 0;
+            pdInGate[i] = 0;
+        }
     }
 
-    return dSummedDistances;
+    return unInGate;
 }
 
 void TrackingParticleFilter::getPersonEstimates()
 {
     vector<double> vecProbabilityEstimate;
 
-    vecProbabilityEstimate.push_back(0.0);
-    vecProbabilityEstimate.push_back(0.0);
-    vecProbabilityEstimate.push_back(0.0);
-
-    for (unsigned int i = 0; i < this->_unNumberOfParticles; ++i)
+    for (unsigned int i = 0; i < this->_strParticleSet.size(); ++i)
     {
-        vecProbabilityEstimate.at(this->_vecParticleSet.at(i)->iCorrespondToObj) += this->_vecParticleSet.at(i)->dWeight;
+        unsigned int unObject = this->_strParticleSet.vecCorrespondToObj[i];
+        if (unObject >= vecProbabilityEstimate.size())
+            vecProbabilityEstimate.resize(unObject + 1, 0.0);
+
+        vecProbabilityEstimate[unObject] += this->_strParticleSet.vecWeight[i];
     }
 
     for (unsigned int j = 0; j < vecProbabilityEstimate.size(); ++j)
@@ -199,158 +367,131 @@ void TrackingParticleFilter::getPersonEstimates()
 
 int TrackingParticleFilter::normalizeParticleWeights(double dSummedWeights)
 {
-    for (unsigned j = 0; j < this->_unNumberOfParticles; ++j)
-    {
-        this->_vecParticleSet.at(j)->dWeight /= dSummedWeights;
-//      cout << "w: " << this->_vecParticleSet.at(j)->dWeight << endl;
-    }
+    unsigned int unSize = this->_strParticleSet.size();
+    double *pdWeight = &this->_strParticleSet.vecWeight[0];
+
+    for (unsigned j = 0; j < unSize; ++j)
+        pdWeight[j] /= dSummedWeights;
 
     return 0;
 }
 
-int TrackingParticleFilter::resampleParticles()
+unsigned int TrackingParticleFilter::getKldParticleCount()
 {
-    vector<StrParticle*> vecNewParticles;
-    StrParticle* tmpParticle = NULL;
-    unsigned int k = 0;
-    int iCountNewParticles = 0;
-
-    sort(this->_vecParticleSet.begin(), this->_vecParticleSet.end(), StrParticle::SortByWeights);
-
-    for (unsigned int i = 0; i < this->_unNumberOfParticles; ++i)
+    const StrParticleSet &strSet = this->_strParticleSet;
+    unsigned int unSize = strSet.size();
+
+    // the bins the particles of a resampling to the maximum size would occupy, copies of a particle share its bin
+    const double *pdWeight = &strSet.vecWeight[0];
+    double dStep = 1.0 / this->_unMaxParticles;
+    double dCumulativeWeight = pdWeight[0];
+    unsigned int i = 0;
+    int iLastIndex = -1;
+
+    this->_vecKldBins.clear();
+    for (unsigned int k = 0; k < this->_unMaxParticles; ++k)
     {
-        iCountNewParticles = (int) round(this->_vecParticleSet.at(i)->dWeight * this->_unNumberOfParticles);
+        double dPointer = (k + 0.5) * dStep;
+        while (dCumulativeWeight < dPointer && i + 1 < unSize)
+            dCumulativeWeight += pdWeight[++i];
 
-        //cout << "weight: "  << this->_vecParticleSet.at(i)->dWeight << " newparticles: " << iCountNewParticles << endl;
-
-        for (int j = 0; j < iCountNewParticles; ++j)
+        if (static_cast<int>(i) != iLastIndex)
         {
-            tmpParticle = new StrParticle();
-            tmpParticle->dOrgX = this->_vecParticleSet.at(i)->dOrgX;
-            tmpParticle->dOrgY = this->_vecParticleSet.at(i)->dOrgY;
-            tmpParticle->dPrevX = this->_vecParticleSet.at(i)->dPrevX;
-            tmpParticle->dPrevY = this->_vecParticleSet.at(i)->dPrevY;
-            tmpParticle->dX = this->_vecParticleSet.at(i)->dX;
-            tmpParticle->dY = this->_vecParticleSet.at(i)->dY;
-            tmpParticle->dWeight = this->_vecParticleSet.at(i)->dWeight;
-            tmpParticle->iCorrespondToObj = this->_vecParticleSet.at(i)->iCorrespondToObj;
-
-            //cout << "id: " << tmpParticle->iCorrespondToObj << endl;
-
-            vecNewParticles.push_back(tmpParticle);
-
-            ++k;
-
-            if (k == this->_unNumberOfParticles)
-            {
-                for (unsigned int l = 0; l < this->_vecParticleSet.size(); ++l)
-                    free(this->_vecParticleSet.at(l));
-
-                this->_vecParticleSet.clear();
-                this->_vecParticleSet.assign(vecNewParticles.begin(), vecNewParticles.end());
-
-                return 0;
-            }
+            this->_vecKldBins.push_back(getCellKey(getCellIndex(strSet.vecX[i], KLD_BIN_SIZE), getCellIndex(strSet.vecY[i], KLD_BIN_SIZE)));
+            iLastIndex = i;
         }
     }
-    while (k < this->_unNumberOfParticles)
-    {
-        tmpParticle = new StrParticle();
 
-        tmpParticle->dOrgX = this->_vecParticleSet.at(0)->dOrgX;
-        tmpParticle->dOrgY = this->_vecParticleSet.at(0)->dOrgY;
-        tmpParticle->dPrevX = this->_vecParticleSet.at(0)->dPrevX;
-        tmpParticle->dPrevY = this->_vecParticleSet.at(0)->dPrevY;
-        tmpParticle->dX = this->_vecParticleSet.at(0)->dX;
-        tmpParticle->dY = this->_vecParticleSet.at(0)->dY;
-        tmpParticle->dWeight = this->_vecParticleSet.at(0)->dWeight;
-        tmpParticle->iCorrespondToObj = this->_vecParticleSet.at(0)->iCorrespondToObj;
+    sort(this->_vecKldBins.begin(), this->_vecKldBins.end());
+    unsigned int unBins = unique(this->_vecKldBins.begin(), this->_vecKldBins.end()) - this->_vecKldBins.begin();
 
-        //  cout << "id: " << tmpParticle->iCorrespondToObj << endl;
+    if (unBins <= 1)
+        return this->_unMinParticles;
 
-        vecNewParticles.push_back(tmpParticle);
+    // number of samples which keep the KL divergence between the sample based and the true posterior below
+    // KLD_EPSILON with probability 1 - delta (Fox, 2003), using the Wilson-Hilferty approximation of the chi-square quantile
+    double dA = 2.0 / (9.0 * (unBins - 1));
+    double dB = 1.0 - dA + sqrt(dA) * KLD_Z;
+    double dRequired = ceil((unBins - 1) / (2.0 * KLD_EPSILON) * dB * dB * dB);
 
-        ++k;
-    }
+    return static_cast<unsigned int>(max<double>(this->_unMinParticles, min<double>(this->_unMaxParticles, dRequired)));
+}
 
-    for (unsigned int m = 0; m < this->_vecParticleSet.size(); ++m)
-        free(this->_vecParticleSet.at(m));
+int TrackingParticleFilter::resampleParticles(unsigned int unNewSize)
+{
+    StrParticleSet &strSet = this->_strParticleSet;
+    StrParticleSet &strNewSet = this->_strResampledParticleSet;
+    unsigned int unSize = strSet.size();
+    double dMostLikelyWeight = -1;
 
-    this->_vecParticleSet.clear();
-    this->_vecParticleSet.assign(vecNewParticles.begin(), vecNewParticles.end());
+    if (unSize == 0 || unNewSize == 0)
+        return 0;
 
-    return 0;
-}
+    strNewSet.resize(unNewSize);
 
-StrPoint* TrackingParticleFilter::getMostLikelyParticle()
-{
-    double dMaxWeight = 0;
-    int unMaxIndex = 0;
-    StrPoint *strTmpPoint = new StrPoint();
+    // systematic resampling: a single random offset and N equally spaced pointers into the cumulative weights,
+    // so every particle gets floor(N * w) or ceil(N * w) copies in one pass
+    const double *pdWeight = &strSet.vecWeight[0];
+    double dStep = 1.0 / unNewSize;
+
+    double dOffset = this->_randomGenerator.getUniform(0.0, dStep);
 
-    for (unsigned int i = 0; i < this->_unNumberOfParticles; ++i)
+    double dCumulativeWeight = pdWeight[0];
+    unsigned int i = 0;
+
+    for (unsigned int k = 0; k < unNewSize; ++k)
     {
-        if (this->_vecParticleSet.at(i)->dWeight >= dMaxWeight)
+        double dPointer = dOffset + k * dStep;
+        while (dCumulativeWeight < dPointer && i + 1 < unSize)
+            dCumulativeWeight += pdWeight[++i];
+
+        // the first copy of the heaviest particle which survives, which is the heaviest one unless the set shrinks
+        if (pdWeight[i] > dMostLikelyWeight)
         {
-            dMaxWeight = this->_vecParticleSet.at(i)->dWeight;
-            unMaxIndex = i;
+            this->_unMostLikelyIndex = k;
+            dMostLikelyWeight = pdWeight[i];
         }
 
+        strNewSet.copyParticle(k, strSet, i);
+        strNewSet.vecWeight[k] = dStep;
     }
 
-    strTmpPoint->dDistance = sqrt(pow(this->_vecParticleSet.at(unMaxIndex)->dX, 2) + pow(this->_vecParticleSet.at(unMaxIndex)->dY, 2));
-    strTmpPoint->dRoll = 0;
-    strTmpPoint->dPitch = 0;
-    strTmpPoint->dYaw = atan(this->_vecParticleSet.at(unMaxIndex)->dY / this->_vecParticleSet.at(unMaxIndex)->dX);
-    strTmpPoint->dX = this->_vecParticleSet.at(unMaxIndex)->dX;
-    strTmpPoint->dY = this->_vecParticleSet.at(unMaxIndex)->dY;
-    strTmpPoint->dZ = 0;
+    // the new set becomes the current one, the old one is the buffer of the next resampling
+    strSet.swap(strNewSet);
+    this->resizeBuffers(unNewSize);
 
-    return strTmpPoint;
+    return 0;
 }
 
-StrPoint* TrackingParticleFilter::getMostLikelyPosition()
+void TrackingParticleFilter::updateEstimates()
 {
-    StrPoint *strTmpPoint = new StrPoint();
-    //int iPercentage = floor(((double)this->_unNumberOfParticles / 100.0 * 10.0));
-
-    //cout << "perc: " << iPercentage << endl;
-
-    //sort(this->_vecParticleSet.begin(), this->_vecParticleSet.end(), StrParticle::SortByWeights);
+    const StrParticleSet &strSet = this->_strParticleSet;
+    double dX = 0, dY = 0;
+    double dSummedWeights = 0;
 
-    for (unsigned int i = 0; i < this->_vecParticleSet.size(); ++i)
+    // weighted mean, the weights are only uniform right after a resampling
+    for (unsigned int i = 0; i < strSet.size(); ++i)
     {
-        strTmpPoint->dX += this->_vecParticleSet.at(i)->dX;
-        strTmpPoint->dY += this->_vecParticleSet.at(i)->dY;
+        dX += strSet.vecWeight[i] * strSet.vecX[i];
+        dY += strSet.vecWeight[i] * strSet.vecY[i];
+        dSummedWeights += strSet.vecWeight[i];
     }
 
-    strTmpPoint->dX /= this->_vecParticleSet.size();
-    strTmpPoint->dY /= this->_vecParticleSet.size();
-    strTmpPoint->dZ = 0;
-    strTmpPoint->dDistance = sqrt(pow(strTmpPoint->dX, 2) + pow(strTmpPoint->dY, 2));
-    strTmpPoint->dRoll = 0;
-    strTmpPoint->dPitch = 0;
-    strTmpPoint->dYaw = atan(strTmpPoint->dY / strTmpPoint->dX);
-
-    return strTmpPoint;
+    if (dSummedWeights > 0)
+        setPlanarPoint(this->_strMostLikelyPosition, dX / dSummedWeights, dY / dSummedWeights);
+    else
+        this->_strMostLikelyPosition = StrPoint();
+
+    // the particle with the largest weight of the last update, the resampling keeps track of it
+    if (this->_unMostLikelyIndex < strSet.size())
+        setPlanarPoint(this->_strMostLikelyParticle, strSet.vecX[this->_unMostLikelyIndex], strSet.vecY[this->_unMostLikelyIndex]);
+    else
+        this->_strMostLikelyParticle = StrPoint();
 }
 
-double TrackingParticleFilter::getGaussian2D(double dXValue, double dYValue, double dXcenter, double dYCenter, double dXSigma, double dYSigma, double dTheta)
+void TrackingParticleFilter::setGaussianCoefficients(double dXSigma, double dYSigma, double dTheta)
 {
-    double dA = 1.0;
-    double da = 0.0, db = 0.0, dc = 0.0;
-    double dZ = 0.0;
-
-    da = (pow(cos(dTheta), 2) / (2 * pow(dXSigma, 2))) + (pow(sin(dTheta), 2) / (2 * pow(dYSigma, 2)));
-    db = (-sin((2 * dTheta)) / (4 * pow(dXSigma, 2))) + (sin((2 * dTheta)) / (4 * pow(dYSigma, 2)));
-    dc = (pow(sin(dTheta), 2) / (2 * pow(dXSigma, 2))) + (pow(cos(dTheta), 2) / (2 * pow(dYSigma, 2)));
-
-    //cout << "da: " << da << " db: " << db << " dc: " << dc << endl;
-
-    dZ = dA * exp(-((da * pow((dXValue - dXcenter), 2)) + (2 * db * (dXValue - dXcenter) * (dYValue - dYCenter)) + (dc * pow((dYValue - dYCenter), 2))));
-
-    //cout << "dZ: " << dZ << endl;
-
-    return dZ;
+    this->_dGaussA = (pow(cos(dTheta), 2) / (2 * pow(dXSigma, 2))) + (pow(sin(dTheta), 2) / (2 * pow(dYSigma, 2)));
+    this->_dGaussB = (-sin((2 * dTheta)) / (4 * pow(dXSigma, 2))) + (sin((2 * dTheta)) / (4 * pow(dYSigma, 2)));
+    this->_dGaussC = (pow(sin(dTheta), 2) / (2 * pow(dXSigma, 2))) + (pow(cos(dTheta), 2) / (2 * pow(dYSigma, 2)));
 }
-
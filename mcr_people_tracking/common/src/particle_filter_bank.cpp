@@ -0,0 +1,264 @@
+/*
+ *  particle_filter_bank.cpp
+ *
+ *  One TrackingParticleFilter per tracked person, updated in parallel.
+ */
+
+#include "mcr_people_tracking/particle_filter_bank.h"
+
+#include <boost/bind.hpp>
+
+TrackingParticleFilterBank::TrackingParticleFilterBank(unsigned int unParticlesPerTarget, unsigned int unNumberOfThreads)
+    : _unParticlesPerTarget(unParticlesPerTarget),
+      _unMinParticles(unParticlesPerTarget),
+      _unMaxParticles(unParticlesPerTarget),
+      _bFixedSeed(false),
+      _unSeed(0),
+      _dGateDistance(0.75),
+      _iNextId(0),
+      _enJob(JOB_PREDICT),
+      _unNextJob(0),
+      _unNumberOfJobs(0),
+      _unPendingJobs(0),
+      _unGeneration(0),
+      _bShutdown(false)
+{
+    for (unsigned int i = 0; i < unNumberOfThreads; ++i)
+        this->_threads.create_thread(boost::bind(&TrackingParticleFilterBank::workerLoop, this));
+}
+
+TrackingParticleFilterBank::~TrackingParticleFilterBank()
+{
+    {
+        boost::mutex::scoped_lock lock(this->_mutex);
+        this->_bShutdown = true;
+    }
+    this->_condWork.notify_all();
+    this->_threads.join_all();
+}
+
+int TrackingParticleFilterBank::addTarget(const mcr_perception_msgs::LaserScanSegment &segment)
+{
+    mcr_perception_msgs::LaserScanSegmentList vecInitial;
+    vecInitial.segments.push_back(segment);
+
+    StrTarget strTarget;
+    strTarget.iId = this->_iNextId++;
+    strTarget.pFilter.reset(new TrackingParticleFilter(this->_unParticlesPerTarget));
+    strTarget.pFilter->setParticleLimits(this->_unMinParticles, this->_unMaxParticles);
+    if (this->_bFixedSeed)
+        strTarget.pFilter->setSeed(this->_unSeed + strTarget.iId);
+    strTarget.pFilter->initialize(vecInitial);
+    strTarget.unMissedUpdates = 0;
+
+    this->_vecTargets.push_back(strTarget);
+
+    return strTarget.iId;
+}
+
+bool TrackingParticleFilterBank::removeTarget(int iId)
+{
+    int iIndex = this->findTarget(iId);
+    if (iIndex < 0)
+        return false;
+
+    this->_vecTargets.erase(this->_vecTargets.begin() + iIndex);
+
+    return true;
+}
+
+void TrackingParticleFilterBank::clear()
+{
+    this->_vecTargets.clear();
+}
+
+void TrackingParticleFilterBank::setParticleLimits(unsigned int unMinParticles, unsigned int unMaxParticles)
+{
+    this->_unMinParticles = unMinParticles;
+    this->_unMaxParticles = unMaxParticles;
+
+    for (unsigned int t = 0; t < this->_vecTargets.size(); ++t)
+        this->_vecTargets[t].pFilter->setParticleLimits(unMinParticles, unMaxParticles);
+}
+
+void TrackingParticleFilterBank::setSeed(uint64_t unSeed)
+{
+    this->_bFixedSeed = true;
+    this->_unSeed = unSeed;
+
+    for (unsigned int t = 0; t < this->_vecTargets.size(); ++t)
+        this->_vecTargets[t].pFilter->setSeed(unSeed + this->_vecTargets[t].iId);
+}
+
+void TrackingParticleFilterBank::predict()
+{
+    this->runForAllTargets(JOB_PREDICT);
+}
+
+void TrackingParticleFilterBank::update(const mcr_perception_msgs::LaserScanSegmentList &vecMeasurements,
+                                        mcr_perception_msgs::LaserScanSegmentList &vecUnassigned)
+{
+    vecUnassigned.segments.clear();
+
+    this->_vecPositions.resize(this->_vecTargets.size());
+    for (unsigned int t = 0; t < this->_vecTargets.size(); ++t)
+    {
+        this->_vecPositions[t] = this->_vecTargets[t].pFilter->getMostLikelyPosition();
+        this->_vecTargets[t].vecSegments.segments.clear();
+    }
+
+    // every segment goes to the closest target within the gate, so neighbouring people do not share measurements
+    for (unsigned int j = 0; j < vecMeasurements.segments.size(); ++j)
+    {
+        const mcr_perception_msgs::LaserScanSegment &segment = vecMeasurements.segments[j];
+        double dMinDistance = this->_dGateDistance;
+        int iClosest = -1;
+
+        for (unsigned int t = 0; t < this->_vecTargets.size(); ++t)
+        {
+            double dDistance = sqrt(pow(segment.center.x - this->_vecPositions[t].dX, 2) + pow(segment.center.y - this->_vecPositions[t].dY, 2));
+            if (dDistance <= dMinDistance)
+            {
+                dMinDistance = dDistance;
+                iClosest = t;
+            }
+        }
+
+        if (iClosest >= 0)
+            this->_vecTargets[iClosest].vecSegments.segments.push_back(segment);
+        else
+            vecUnassigned.segments.push_back(segment);
+    }
+
+    for (unsigned int t = 0; t < this->_vecTargets.size(); ++t)
+    {
+        if (this->_vecTargets[t].vecSegments.segments.empty())
+            ++this->_vecTargets[t].unMissedUpdates;
+        else
+            this->_vecTargets[t].unMissedUpdates = 0;
+    }
+
+    this->runForAllTargets(JOB_UPDATE);
+}
+
+vector<int> TrackingParticleFilterBank::getTargetIds() const
+{
+    vector<int> vecIds;
+    for (unsigned int t = 0; t < this->_vecTargets.size(); ++t)
+        vecIds.push_back(this->_vecTargets[t].iId);
+
+    return vecIds;
+}
+
+const TrackingParticleFilter* TrackingParticleFilterBank::getTarget(int iId) const
+{
+    int iIndex = this->findTarget(iId);
+    if (iIndex < 0)
+        return NULL;
+
+    return this->_vecTargets[iIndex].pFilter.get();
+}
+
+unsigned int TrackingParticleFilterBank::getMissedUpdates(int iId) const
+{
+    int iIndex = this->findTarget(iId);
+    if (iIndex < 0)
+        return 0;
+
+    return this->_vecTargets[iIndex].unMissedUpdates;
+}
+
+int TrackingParticleFilterBank::findTarget(int iId) const
+{
+    for (unsigned int t = 0; t < this->_vecTargets.size(); ++t)
+    {
+        if (this->_vecTargets[t].iId == iId)
+            return t;
+    }
+
+    return -1;
+}
+
+void TrackingParticleFilterBank::runForAllTargets(EnJob enJob)
+{
+    unsigned int unNumberOfTargets = this->_vecTargets.size();
+
+    // a single target is not worth waking up the workers
+    if (unNumberOfTargets <= 1 || this->_threads.size() == 0)
+    {
+        this->_enJob = enJob;
+        for (unsigned int t = 0; t < unNumberOfTargets; ++t)
+            this->runJob(t);
+
+        return;
+    }
+
+    {
+        boost::mutex::scoped_lock lock(this->_mutex);
+        this->_enJob = enJob;
+        this->_unNextJob = 0;
+        this->_unNumberOfJobs = unNumberOfTargets;
+        this->_unPendingJobs = unNumberOfTargets;
+        ++this->_unGeneration;
+    }
+    this->_condWork.notify_all();
+
+    // the calling thread helps instead of idling
+    this->runJobs();
+
+    boost::mutex::scoped_lock lock(this->_mutex);
+    while (this->_unPendingJobs > 0)
+        this->_condDone.wait(lock);
+}
+
+void TrackingParticleFilterBank::runJobs()
+{
+    while (true)
+    {
+        unsigned int unTarget = 0;
+        {
+            boost::mutex::scoped_lock lock(this->_mutex);
+            if (this->_unNextJob >= this->_unNumberOfJobs)
+                return;
+
+            unTarget = this->_unNextJob++;
+        }
+
+        this->runJob(unTarget);
+
+        boost::mutex::scoped_lock lock(this->_mutex);
+        if (--this->_unPendingJobs == 0)
+            this->_condDone.notify_all();
+    }
+}
+
+void TrackingParticleFilterBank::runJob(unsigned int unTarget)
+{
+    StrTarget &strTarget = this->_vecTargets[unTarget];
+
+    if (this->_enJob == JOB_PREDICT)
+        strTarget.pFilter->predict();
+    else if (!strTarget.vecSegments.segments.empty())
+        strTarget.pFilter->update(strTarget.vecSegments);
+}
+
+void TrackingParticleFilterBank::workerLoop()
+{
+    unsigned int unSeenGeneration = 0;
+
+    while (true)
+    {
+        {
+            boost::mutex::scoped_lock lock(this->_mutex);
+            while (!this->_bShutdown && this->_unGeneration == unSeenGeneration)
+                this->_condWork.wait(lock);
+
+            if (this->_bShutdown)
+                return;
+
+            unSeenGeneration = this->_unGeneration;
+        }
+
+        this->runJobs();
+    }
+}
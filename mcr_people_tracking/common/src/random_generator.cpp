@@ -0,0 +1,101 @@
+/*
+ *  random_generator.cpp
+ *
+ *  xoshiro256+ generator which produces uniform random numbers in blocks.
+ */
+
+#include "mcr_people_tracking/random_generator.h"
+
+#include <string.h>
+
+namespace
+{
+/*
+ * splitmix64, spreads a seed over the state words so that similar seeds give unrelated streams
+ */
+inline uint64_t splitMix(uint64_t &unState)
+{
+    uint64_t unZ = (unState += 0x9E3779B97F4A7C15ULL);
+    unZ = (unZ ^ (unZ >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    unZ = (unZ ^ (unZ >> 27)) * 0x94D049BB133111EBULL;
+
+    return unZ ^ (unZ >> 31);
+}
+}
+
+BlockRandomGenerator::BlockRandomGenerator(uint64_t unSeed)
+{
+    this->seed(unSeed);
+}
+
+void BlockRandomGenerator::seed(uint64_t unSeed)
+{
+    uint64_t unState = unSeed;
+
+    for (unsigned int l = 0; l < RANDOM_LANES; ++l)
+    {
+        this->_unState0[l] = splitMix(unState);
+        this->_unState1[l] = splitMix(unState);
+        this->_unState2[l] = splitMix(unState);
+        this->_unState3[l] = splitMix(unState);
+    }
+
+    this->_unBufferPosition = RANDOM_LANES;
+}
+
+void BlockRandomGenerator::generateBlock(double *pdValues)
+{
+    uint64_t unBits[RANDOM_LANES];
+
+    // xoshiro256+ on every lane, only shifts, xors and adds, so the loop maps to vector instructions
+    for (unsigned int l = 0; l < RANDOM_LANES; ++l)
+    {
+        uint64_t unResult = this->_unState0[l] + this->_unState3[l];
+        uint64_t unT = this->_unState1[l] << 17;
+
+        this->_unState2[l] ^= this->_unState0[l];
+        this->_unState3[l] ^= this->_unState1[l];
+        this->_unState1[l] ^= this->_unState2[l];
+        this->_unState0[l] ^= this->_unState3[l];
+        this->_unState2[l] ^= unT;
+        this->_unState3[l] = (this->_unState3[l] << 45) | (this->_unState3[l] >> 19);
+
+        // the upper 52 bits become the mantissa of a double in [1, 2), which avoids an integer conversion
+        unBits[l] = (unResult >> 12) | 0x3FF0000000000000ULL;
+    }
+
+    memcpy(pdValues, unBits, sizeof(unBits));
+}
+
+void BlockRandomGenerator::fillUniform(double *pdValues, unsigned int unSize, double dMin, double dMax)
+{
+    unsigned int i = 0;
+
+    // numbers left over from the last call come first, so the sequence does not depend on the block boundaries
+    while (i < unSize && this->_unBufferPosition < RANDOM_LANES)
+        pdValues[i++] = this->_dBuffer[this->_unBufferPosition++];
+
+    for (; i + RANDOM_LANES <= unSize; i += RANDOM_LANES)
+        this->generateBlock(pdValues + i);
+
+    if (i < unSize)
+    {
+        this->generateBlock(this->_dBuffer);
+        this->_unBufferPosition = 0;
+
+        while (i < unSize)
+            pdValues[i++] = this->_dBuffer[this->_unBufferPosition++];
+    }
+
+    double dRange = dMax - dMin;
+    for (i = 0; i < unSize; ++i)
+        pdValues[i] = dMin + (pdValues[i] - 1.0) * dRange;
+}
+
+double BlockRandomGenerator::getUniform(double dMin, double dMax)
+{
+    double dValue;
+    this->fillUniform(&dValue, 1, dMin, dMax);
+
+    return dValue;
+}
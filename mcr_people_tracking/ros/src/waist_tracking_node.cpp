@@ -9,8 +9,12 @@
  */
 
 #include "mcr_people_tracking/particle_filter.h"
+#include "mcr_people_tracking/particle_filter_bank.h"
+#include "mcr_people_tracking/random_generator.h"
 
+#include <limits>
 #include <list>
+#include <string.h>
 
 #include <ros/ros.h>
 #include <ros/package.h>
@@ -42,14 +46,25 @@
 #define FIXED_FRAME                 "/base_link"
 #define FIND_PERSON_IN_RANGE        0
 #define FIND_PERSON_BY_HISTOGRAM    1
+#define SEARCH_COLUMN_RADIUS        0.3
+#define SEARCH_VOXEL_SIZE           0.03
+#define SEARCH_MIN_VOXELS           100
+#define HUE_BIN_SIZE                30
+#define SATURATION_BIN_SIZE         32
+#define HSV_SHIFT                   12
 
 using namespace std;
 
 LaserScanSegmentation* segmentor;
-TrackingParticleFilter* tracker;
+TrackingParticleFilterBank* tracker;
+int owner_target_id = -1;
+int number_of_threads = 1;
+int random_seed = -1;
 tf::TransformListener *transform_listener;
 
 pcl::PointCloud<pcl::PointXYZRGB>::Ptr pcl_cloud_input;
+sensor_msgs::PointCloud2::ConstPtr latest_cloud2;           // converted only when the initialization needs it
+sensor_msgs::PointCloud2::ConstPtr last_searched_cloud2;
 bool is_pointcloud_received = false;
 cv::Mat initial_person_histogram;
 double teached_person_min_z = 0;
@@ -131,13 +146,91 @@ void publishVisualizationMarker(const mcr_perception_msgs::PersonList &person_li
 
 
 
-bool is_in_vector(vector<unsigned int> vector_input, unsigned int value)
+/*
+ * draws number_of_samples distinct indices out of [0, number_of_points) with a partial Fisher-Yates shuffle
+ */
+void samplePointIndices(unsigned int number_of_points, unsigned int number_of_samples, BlockRandomGenerator &generator,
+                        vector<unsigned int> &indices)
+{
+    indices.resize(number_of_points);
+    for (unsigned int i = 0; i < number_of_points; ++i)
+        indices[i] = i;
+
+    number_of_samples = min(number_of_samples, number_of_points);
+    for (unsigned int k = 0; k < number_of_samples; ++k)
+    {
+        unsigned int remaining = number_of_points - k;
+        unsigned int offset = min(static_cast<unsigned int>(generator.getUniform(0, remaining)), remaining - 1);
+        swap(indices[k], indices[k + offset]);
+    }
+
+    indices.resize(number_of_samples);
+}
+
+/*
+ * the fixed point divisions of the 8 bit HSV conversion of OpenCV and the bin of every hue and saturation value
+ */
+struct HueSaturationTables
+{
+    int saturation_division[256], hue_division[256];
+    int hue_bin[256], saturation_bin[256];
+
+    HueSaturationTables()
+    {
+        saturation_division[0] = hue_division[0] = 0;
+        for (int i = 1; i < 256; ++i)
+        {
+            saturation_division[i] = cvRound((255 << HSV_SHIFT) / (1. * i));
+            hue_division[i] = cvRound((180 << HSV_SHIFT) / (6. * i));
+        }
+
+        double hue_scale = HUE_BIN_SIZE / 180.0, sat_scale = SATURATION_BIN_SIZE / 256.0;
+        for (int i = 0; i < 256; ++i)
+        {
+            int bin = cvFloor(i * hue_scale);
+            hue_bin[i] = (bin < HUE_BIN_SIZE) ? bin : -1;
+            saturation_bin[i] = cvFloor(i * sat_scale);
+        }
+    }
+};
+
+// built before main, so the search threads only ever read it
+const HueSaturationTables hue_saturation_tables;
+
+/*
+ * hue-saturation histogram of the points with 30 hue bins over [0, 180) and 32 saturation bins over [0, 256). It
+ * gives the same counts as cv::cvtColor(CV_BGR2HSV) followed by cv::calcHist, but reads the colors straight from
+ * the points.
+ */
+void calculateHueSaturationHistogram(const pcl::PointCloud<pcl::PointXYZRGB> &cloud, cv::Mat &histogram)
 {
-    for (unsigned int i = 0; i < vector_input.size(); ++i)
-        if (vector_input[i] == value)
-            return true;
+    const int *saturation_division = hue_saturation_tables.saturation_division;
+    const int *hue_division = hue_saturation_tables.hue_division;
+    const int *hue_bin = hue_saturation_tables.hue_bin;
+    const int *saturation_bin = hue_saturation_tables.saturation_bin;
 
-    return false;
+    histogram = cv::Mat::zeros(HUE_BIN_SIZE, SATURATION_BIN_SIZE, CV_32F);
+    float *bins = histogram.ptr<float>();
+
+    for (unsigned int j = 0; j < cloud.points.size(); ++j)
+    {
+        const unsigned char *color = reinterpret_cast<const unsigned char *>(&cloud.points[j].rgb);
+        int b = color[0], g = color[1], r = color[2];
+
+        int v = max(b, max(g, r));
+        int diff = v - min(b, min(g, r));
+        int vr = (v == r) ? -1 : 0;
+        int vg = (v == g) ? -1 : 0;
+
+        int s = (diff * saturation_division[v] + (1 << (HSV_SHIFT - 1))) >> HSV_SHIFT;
+        int h = (vr & (g - b)) + (~vr & ((vg & (b - r + 2 * diff)) + ((~vg) & (r - g + 4 * diff))));
+        h = (h * hue_division[diff] + (1 << (HSV_SHIFT - 1))) >> HSV_SHIFT;
+        h += (h < 0) ? 180 : 0;
+
+        int bin = hue_bin[min(h, 255)];
+        if (bin >= 0)
+            ++bins[bin * SATURATION_BIN_SIZE + saturation_bin[s]];
+    }
 }
 
 bool reinitialize_tracking_with_histogram_search(std_srvs::Empty::Request& request, std_srvs::Empty::Response& response)
@@ -146,6 +239,7 @@ bool reinitialize_tracking_with_histogram_search(std_srvs::Empty::Request& reque
     tracker_init_state = FIND_PERSON_BY_HISTOGRAM;
     is_tracker_initialized = false;
     is_pointcloud_processing_enabled = true;
+    last_searched_cloud2.reset();
 
     ROS_INFO("reinitialize tracking with searching for person by color histogram");
 
@@ -159,25 +253,244 @@ void pointCloudCallback(const sensor_msgs::PointCloud2::ConstPtr& cloud2_input)
     if (!is_pointcloud_processing_enabled)
         return;
 
-    sensor_msgs::PointCloud2 cloud2_transformed;
+    // only keep the message, nearly all clouds are replaced before the initialization uses one
+    latest_cloud2 = cloud2_input;
+    is_pointcloud_received = true;
+}
+
+/*
+ * pinhole model of an organized cloud: pixel (u, v) = (focal_u * x / z + center_u, focal_v * y / z + center_v)
+ */
+struct CloudProjection
+{
+    bool is_valid;
+    double focal_u, center_u;
+    double focal_v, center_v;
+};
 
-    try
+/*
+ * the points above one laser segment, cut from the latest cloud for the histogram search
+ */
+struct CloudColumn
+{
+    mcr_perception_msgs::LaserScanSegment segment;
+    tf::Vector3 center;                 // segment center in the fixed frame
+    int min_u, max_u, min_v, max_v;     // pixel window of the column in the cloud
+    uint64_t random_seed;
+    float histogram_error;              // negative if the column has too few points
+    double max_z;
+};
+
+int getFieldOffset(const sensor_msgs::PointCloud2 &cloud2, const string &name)
+{
+    for (unsigned int i = 0; i < cloud2.fields.size(); ++i)
     {
-        transform_listener->waitForTransform(FIXED_FRAME, cloud2_input->header.frame_id, cloud2_input->header.stamp, ros::Duration(2.0));
-        pcl_ros::transformPointCloud(FIXED_FRAME, *cloud2_input, cloud2_transformed, *transform_listener);
+        if (cloud2.fields[i].name == name)
+            return cloud2.fields[i].offset;
+    }
 
-        if (cloud2_transformed.width <= 0 || cloud2_transformed.height <= 0)
+    return -1;
+}
+
+inline float getFloatField(const uint8_t *point, int offset)
+{
+    float value;
+    memcpy(&value, point + offset, sizeof(value));
+
+    return value;
+}
+
+/*
+ * the cloud does not come with its camera info, but every valid point of an organized cloud lies on the ray of its
+ * pixel. A line fit of the pixel coordinates against x / z and y / z on a sparse grid of points recovers the
+ * projection.
+ */
+CloudProjection estimateCloudProjection(const sensor_msgs::PointCloud2 &cloud2)
+{
+    CloudProjection projection;
+    projection.is_valid = false;
+
+    int offset_x = getFieldOffset(cloud2, "x"), offset_y = getFieldOffset(cloud2, "y"), offset_z = getFieldOffset(cloud2, "z");
+    if (cloud2.height <= 1 || offset_x < 0 || offset_y < 0 || offset_z < 0)
+        return projection;
+
+    const unsigned int stride = 8;
+    vector<double> vec_u, vec_v, vec_a, vec_b;
+
+    for (unsigned int v = 0; v < cloud2.height; v += stride)
+    {
+        for (unsigned int u = 0; u < cloud2.width; u += stride)
         {
-            ROS_WARN("Skip point cloud, because transformation for it is too old");
-            return;
+            const uint8_t *point = &cloud2.data[v * cloud2.row_step + u * cloud2.point_step];
+            float x = getFloatField(point, offset_x), y = getFloatField(point, offset_y), z = getFloatField(point, offset_z);
+
+            if (!pcl_isfinite(x) || !pcl_isfinite(y) || !pcl_isfinite(z) || z <= 0)
+                continue;
+
+            vec_u.push_back(u);
+            vec_v.push_back(v);
+            vec_a.push_back(x / z);
+            vec_b.push_back(y / z);
         }
+    }
+
+    if (vec_u.size() < 10)
+        return projection;
 
-        pcl::fromROSMsg(cloud2_transformed, *pcl_cloud_input);
-        is_pointcloud_received = true;
+    double n = vec_u.size();
+    double sum_u = 0, sum_v = 0, sum_a = 0, sum_b = 0, sum_aa = 0, sum_bb = 0, sum_ua = 0, sum_vb = 0;
+    for (unsigned int i = 0; i < vec_u.size(); ++i)
+    {
+        sum_u += vec_u[i];
+        sum_v += vec_v[i];
+        sum_a += vec_a[i];
+        sum_b += vec_b[i];
+        sum_aa += vec_a[i] * vec_a[i];
+        sum_bb += vec_b[i] * vec_b[i];
+        sum_ua += vec_u[i] * vec_a[i];
+        sum_vb += vec_v[i] * vec_b[i];
     }
-    catch (tf::TransformException ex)
+
+    double var_a = n * sum_aa - sum_a * sum_a, var_b = n * sum_bb - sum_b * sum_b;
+    if (var_a <= 0 || var_b <= 0)
+        return projection;
+
+    projection.focal_u = (n * sum_ua - sum_u * sum_a) / var_a;
+    projection.center_u = (sum_u - projection.focal_u * sum_a) / n;
+    projection.focal_v = (n * sum_vb - sum_v * sum_b) / var_b;
+    projection.center_v = (sum_v - projection.focal_v * sum_b) / n;
+
+    // clouds which are not a single pinhole image, e.g. registered from several cameras, are searched completely
+    for (unsigned int i = 0; i < vec_u.size(); ++i)
     {
-        ROS_WARN("Waiting for TF");
+        if (fabs(projection.focal_u * vec_a[i] + projection.center_u - vec_u[i]) > 1.0
+                || fabs(projection.focal_v * vec_b[i] + projection.center_v - vec_v[i]) > 1.0)
+            return projection;
+    }
+
+    projection.is_valid = true;
+
+    return projection;
+}
+
+/*
+ * projects the box around the column into the cloud, the window is the whole cloud if that is not possible
+ */
+void setColumnWindow(CloudColumn &column, const sensor_msgs::PointCloud2 &cloud2, const tf::Transform &fixed_to_cloud,
+                     const CloudProjection &projection)
+{
+    column.min_u = 0;
+    column.max_u = cloud2.width - 1;
+    column.min_v = 0;
+    column.max_v = cloud2.height - 1;
+
+    if (!projection.is_valid)
+        return;
+
+    double min_u = numeric_limits<double>::max(), max_u = -numeric_limits<double>::max();
+    double min_v = numeric_limits<double>::max(), max_v = -numeric_limits<double>::max();
+
+    for (unsigned int k = 0; k < 8; ++k)
+    {
+        tf::Vector3 corner(column.center.x() + ((k & 1) ? SEARCH_COLUMN_RADIUS : -SEARCH_COLUMN_RADIUS),
+                           column.center.y() + ((k & 2) ? SEARCH_COLUMN_RADIUS : -SEARCH_COLUMN_RADIUS),
+                           (k & 4) ? 2.0 : teached_person_min_z);
+        tf::Vector3 point = fixed_to_cloud * corner;
+
+        // the column reaches behind the camera
+        if (point.z() <= 0)
+            return;
+
+        double u = projection.focal_u * point.x() / point.z() + projection.center_u;
+        double v = projection.focal_v * point.y() / point.z() + projection.center_v;
+
+        min_u = min(min_u, u);
+        max_u = max(max_u, u);
+        min_v = min(min_v, v);
+        max_v = max(max_v, v);
+    }
+
+    column.min_u = static_cast<int>(floor(max(min_u, 0.0)));
+    column.max_u = static_cast<int>(ceil(min(max_u, cloud2.width - 1.0)));
+    column.min_v = static_cast<int>(floor(max(min_v, 0.0)));
+    column.max_v = static_cast<int>(ceil(min(max_v, cloud2.height - 1.0)));
+}
+
+/*
+ * cuts every step-th column starting at first out of the cloud and compares its histogram with the one of the owner
+ */
+void searchCloudColumns(const sensor_msgs::PointCloud2 &cloud2, const tf::Transform &cloud_to_fixed, vector<CloudColumn> &columns,
+                        unsigned int first, unsigned int step)
+{
+    int offset_x = getFieldOffset(cloud2, "x"), offset_y = getFieldOffset(cloud2, "y"), offset_z = getFieldOffset(cloud2, "z");
+    int offset_rgb = getFieldOffset(cloud2, "rgb");
+    const double squared_radius = SEARCH_COLUMN_RADIUS * SEARCH_COLUMN_RADIUS;
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr pcl_column(new pcl::PointCloud<pcl::PointXYZRGB>);
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr pcl_thinned_column(new pcl::PointCloud<pcl::PointXYZRGB>);
+    pcl::PointCloud<pcl::PointXYZRGB> pcl_random_point_set;
+    vector<unsigned int> sampled_indices;
+
+    for (unsigned int c = first; c < columns.size(); c += step)
+    {
+        CloudColumn &column = columns[c];
+        column.histogram_error = -1;
+
+        if (offset_x < 0 || offset_y < 0 || offset_z < 0 || offset_rgb < 0)
+            continue;
+
+        pcl_column->points.clear();
+        for (int v = column.min_v; v <= column.max_v; ++v)
+        {
+            for (int u = column.min_u; u <= column.max_u; ++u)
+            {
+                const uint8_t *point = &cloud2.data[v * cloud2.row_step + u * cloud2.point_step];
+                float x = getFloatField(point, offset_x), y = getFloatField(point, offset_y), z = getFloatField(point, offset_z);
+
+                if (!pcl_isfinite(x) || !pcl_isfinite(y) || !pcl_isfinite(z))
+                    continue;
+
+                tf::Vector3 fixed_point = cloud_to_fixed * tf::Vector3(x, y, z);
+                double dx = fixed_point.x() - column.center.x(), dy = fixed_point.y() - column.center.y();
+
+                if (dx * dx + dy * dy > squared_radius || fixed_point.z() < teached_person_min_z || fixed_point.z() > 2.0)
+                    continue;
+
+                pcl::PointXYZRGB pcl_point;
+                pcl_point.x = fixed_point.x();
+                pcl_point.y = fixed_point.y();
+                pcl_point.z = fixed_point.z();
+                memcpy(&pcl_point.rgb, point + offset_rgb, sizeof(pcl_point.rgb));
+
+                pcl_column->points.push_back(pcl_point);
+            }
+        }
+
+        // the number of pixels on a person depends on the distance and the camera, the occupied voxels do not
+        pcl_column->width = pcl_column->points.size();
+        pcl_column->height = 1;
+        PCLWrapper<pcl::PointXYZRGB>::downsampling(pcl_column, pcl_thinned_column, SEARCH_VOXEL_SIZE);
+
+        if (pcl_thinned_column->points.size() < SEARCH_MIN_VOXELS)
+            continue;
+
+        // get fixed set of random points at full resolution, like the ones the owner histogram was taught from
+        BlockRandomGenerator generator(column.random_seed);
+        samplePointIndices(pcl_column->points.size(), 5000, generator, sampled_indices);
+        pcl_random_point_set.points.resize(sampled_indices.size());
+        for (unsigned int k = 0; k < sampled_indices.size(); ++k)
+            pcl_random_point_set.points[k] = pcl_column->points[sampled_indices[k]];
+
+        double min_x, max_x, min_y, max_y, min_z, max_z;
+        MinMax::determineMinMax3D(pcl_random_point_set, min_x, max_x, min_y, max_y, min_z, max_z);
+        column.max_z = max_z;
+
+        // calculate the histogram for the detected person
+        cv::Mat histogram;
+        calculateHueSaturationHistogram(pcl_random_point_set, histogram);
+
+        // CV_COMP_CORREL, CV_COMP_INTERSECT, CV_COMP_BHATTACHARYYA, CV_COMP_CHISQR
+        column.histogram_error = cv::compareHist(histogram, initial_person_histogram, CV_COMP_BHATTACHARYYA);
     }
 }
 
@@ -185,6 +498,12 @@ void dynamic_reconfig_callback(mcr_people_tracking::WaistTrackingConfig &config,
 {
     dyn_recfg_parameters = config;
     dyn_recfg_parameters.angular_range_for_searching /= 2;
+
+    if (tracker != NULL)
+    {
+        tracker->setGateDistance(config.association_gate);
+        tracker->setParticleLimits(config.min_particles, config.max_particles);
+    }
 }
 
 void laserScanCallback(const sensor_msgs::LaserScan::ConstPtr& inputScan)
@@ -209,10 +528,8 @@ void laserScanCallback(const sensor_msgs::LaserScan::ConstPtr& inputScan)
                 if (dDistance < dyn_recfg_parameters.distance_range_for_searching && dAngle > -dyn_recfg_parameters.angular_range_for_searching && dAngle < dyn_recfg_parameters.angular_range_for_searching
                         && is_pointcloud_received)
                 {
-                    mcr_perception_msgs::LaserScanSegmentList temp;
-                    temp.segments.push_back(segmentList.segments[i]);
-
-                    tracker->initialize(temp);
+                    tracker->clear();
+                    owner_target_id = tracker->addTarget(segmentList.segments[i]);
 
                     /*
                           // cut down the pointcloud to the ROI
@@ -301,174 +618,117 @@ void laserScanCallback(const sensor_msgs::LaserScan::ConstPtr& inputScan)
             }
         }
 
-        if (tracker_init_state == FIND_PERSON_BY_HISTOGRAM && is_pointcloud_received)
+        // the owner is searched above the laser segments: a column around every segment is cut from the latest cloud
+        // and only the points inside are histogrammed. A cloud is only searched once.
+        if (tracker_init_state == FIND_PERSON_BY_HISTOGRAM && is_pointcloud_received && latest_cloud2 != last_searched_cloud2)
         {
-            pcl::PointCloud < pcl::PointXYZRGB > pcl_projected_cloud;
-            pcl::PointCloud<pcl::PointXYZRGB>::Ptr pcl_passthrough(new pcl::PointCloud<pcl::PointXYZRGB>);
-            pcl::PointCloud<pcl::PointXYZRGB>::Ptr pcl_2d_segment(new pcl::PointCloud<pcl::PointXYZRGB>);
-            pcl::PointCloud<pcl::PointXYZRGB>::Ptr pcl_3d_segment(new pcl::PointCloud<pcl::PointXYZRGB>);
-            pcl::PointCloud<pcl::PointXYZRGB>::Ptr pcl_2d_hull(new pcl::PointCloud<pcl::PointXYZRGB>);
-            vector<PointIndices> vec_2d_segment_indices;
-
-            // preprocessing: cropping and downsampling
-            PCLWrapper<pcl::PointXYZRGB>::passThroughFilter(pcl_cloud_input, pcl_cloud_input, "x", 0, 3.0);
-            PCLWrapper<pcl::PointXYZRGB>::passThroughFilter(pcl_cloud_input, pcl_passthrough, "z", teached_person_min_z, 2.0);
-            PCLWrapper<pcl::PointXYZRGB>::downsampling(pcl_passthrough, pcl_cloud_input, 0.03);
-
-            // project cloud to 2d
-            PointCloudProjections::projection2_5D(*pcl_cloud_input, pcl_projected_cloud, "z");
-
-            // cluster 2d projection
-            PCLWrapper<pcl::PointXYZRGB>::clustering(pcl_projected_cloud.makeShared(), vec_2d_segment_indices, 0.10, 0, 100000);
-            double min_hist_error = 9999;
-            bool found_owner = false;
-            mcr_perception_msgs::LaserScanSegment owner_pos;
+            tf::StampedTransform cloud_to_fixed, scan_to_fixed;
 
-            for (unsigned int i = 0; i < vec_2d_segment_indices.size(); ++i)
+            try
             {
-                //convert indices to single point clouds
-                copyPointCloud(pcl_projected_cloud, vec_2d_segment_indices[i], *pcl_2d_segment);
-
-                // Todo: delete
-                /*
-                 sensor_msgs::PointCloud2 temp;
-                 pcl::toROSMsg(*pcl_2d_segment, temp);
-                 pubTemp.publish(temp);
-                 */
+                transform_listener->waitForTransform(FIXED_FRAME, latest_cloud2->header.frame_id, latest_cloud2->header.stamp, ros::Duration(0.1));
+                transform_listener->lookupTransform(FIXED_FRAME, latest_cloud2->header.frame_id, latest_cloud2->header.stamp, cloud_to_fixed);
+                transform_listener->waitForTransform(FIXED_FRAME, inputScan->header.frame_id, inputScan->header.stamp, ros::Duration(0.1));
+                transform_listener->lookupTransform(FIXED_FRAME, inputScan->header.frame_id, inputScan->header.stamp, scan_to_fixed);
+            }
+            catch (tf::TransformException ex)
+            {
+                ROS_WARN("Waiting for TF");
+                return;
+            }
 
-                //get convex hull of the 2d projected segment
-                PCLWrapper<pcl::PointXYZRGB>::extractConvexHull(pcl_2d_segment, pcl_2d_hull);
+            last_searched_cloud2 = latest_cloud2;
 
-                if (pcl_2d_hull->size() < 2)
-                    continue;
+            CloudProjection projection = estimateCloudProjection(*latest_cloud2);
+            tf::Transform fixed_to_cloud = cloud_to_fixed.inverse();
 
-                PCLWrapper<pcl::PointXYZRGB>::get3DPointsWithinHull(pcl_passthrough, pcl_2d_hull, teached_person_min_z, 2.0, pcl_3d_segment);
+            // the segments up to 3 m in front of the robot are candidates
+            vector<CloudColumn> columns;
+            for (unsigned int i = 0; i < segmentList.segments.size(); ++i)
+            {
+                CloudColumn column;
+                column.segment = segmentList.segments[i];
+                column.center = scan_to_fixed * tf::Vector3(column.segment.center.x, column.segment.center.y, 0);
 
-                if (pcl_3d_segment->points.size() < 5000)
+                if (column.center.x() < 0 || column.center.x() > 3.0)
                     continue;
 
-                // get fixed set of random points
-                pcl::PointCloud < pcl::PointXYZRGB > pcl_random_point_set;
-                vector<unsigned int> used_indices;
-
-                pcl_random_point_set.header = pcl_3d_segment->header;
-
-                for (unsigned int k = 0; k < 5000;)
-                {
-                    unsigned int rand_index = rand() % pcl_3d_segment->points.size();
-
-                    //cout << "index: " << rand_index << " is in vector: " << is_in_vector(used_indices, rand_index) << endl;
-
-                    if (!is_in_vector(used_indices, rand_index))
-                    {
-                        pcl_random_point_set.points.push_back(pcl_3d_segment->points[rand_index]);
-                        used_indices.push_back(rand_index);
-                        ++k;
-                    }
-                }
-
-                *pcl_3d_segment = pcl_random_point_set;
-
-                // get min z value for later recognition
-                double min_x, max_x, min_y, max_y, min_z, max_z;
-                MinMax::determineMinMax3D(*pcl_3d_segment, min_x, max_x, min_y, max_y, min_z, max_z);
-
-                //ToDo:: height feature disabled
-                //cout << "max_z: " << max_z << "(teached_person_height - 0.02): " << (teached_person_height - 0.02) << " (teached_person_height + 0.02): " << (teached_person_height + 0.02) << endl;
+                setColumnWindow(column, *latest_cloud2, fixed_to_cloud, projection);
 
-                //if(max_z < (teached_person_height - 0.02) || max_z > (teached_person_height + 0.02))
-                //continue;
-
-                //copy only ROI points to an opencv image
-                IplImage* ipl_roi_segment = cvCreateImage(cvSize(pcl_3d_segment->points.size(), 1), IPL_DEPTH_8U, 3);
-                for (unsigned int j = 0; j < pcl_3d_segment->points.size(); ++j)
-                {
-                    const unsigned char *color = reinterpret_cast<const unsigned char *>(&pcl_3d_segment->points[j].rgb);
-                    cvSet2D(ipl_roi_segment, 0, j, cvScalar(color[0], color[1], color[2]));  // cvScalar(b, g, r)
-                }
-
-                // calculate the histogram for the detected person
-                cv::Mat mat_roi_segment_bgr = cv::cvarrToMat(ipl_roi_segment);
-                cv::Mat mat_roi_segment_hsv;
+                // with a fixed seed the samples only depend on the cloud, so a recorded run is searched the same way
+                if (random_seed >= 0)
+                    column.random_seed = static_cast<uint64_t>(random_seed) + latest_cloud2->header.stamp.toNSec() + i;
+                else
+                    column.random_seed = rand();
+                columns.push_back(column);
+            }
 
-                cv::cvtColor(mat_roi_segment_bgr, mat_roi_segment_hsv, CV_BGR2HSV);
+            // the columns are independent, so they are searched on all threads
+            unsigned int number_of_workers = max(1, min(number_of_threads, static_cast<int>(columns.size())));
+            boost::thread_group workers;
+            for (unsigned int t = 1; t < number_of_workers; ++t)
+                workers.create_thread(boost::bind(&searchCloudColumns, boost::cref(*latest_cloud2), boost::cref(cloud_to_fixed), boost::ref(columns),
+                                                  t, number_of_workers));
 
-                cv::Mat histogram, equalized_histogram;
-                int hue_bin_size = 30, sat_bin_size = 32;
-                int histogram_size[] =
-                { hue_bin_size, sat_bin_size };
-                float hue_range[] =
-                { 0, 180 }, sat_range[] =
-                { 0, 256 };
-                const float *ranges[] =
-                { hue_range, sat_range };
-                int channels[] =
-                { 0, 1 };
+            searchCloudColumns(*latest_cloud2, cloud_to_fixed, columns, 0, number_of_workers);
+            workers.join_all();
 
-                cv::calcHist(&mat_roi_segment_hsv, 1, channels, cv::Mat(), histogram, 1, histogram_size, ranges);
+            double min_hist_error = 9999;
+            int owner_column = -1;
 
-                // CV_COMP_CORREL, CV_COMP_INTERSECT, CV_COMP_BHATTACHARYYA, CV_COMP_CHISQR
-                float hist_error = cv::compareHist(histogram, initial_person_histogram, CV_COMP_BHATTACHARYYA);
+            for (unsigned int c = 0; c < columns.size(); ++c)
+            {
+                if (columns[c].histogram_error < 0)
+                    continue;
 
-                if (hist_error < 0.5)
-                    ROS_INFO_STREAM("Hist-Error: " << hist_error << " HEIGHT: " << max_z);
-                //ROS_INFO_STREAM("Points:" << pcl_3d_segment.points.size());
+                if (columns[c].histogram_error < 0.5)
+                    ROS_INFO_STREAM("Hist-Error: " << columns[c].histogram_error << " HEIGHT: " << columns[c].max_z);
 
-                if (hist_error < 0.5)
+                if (columns[c].histogram_error < 0.5 && columns[c].histogram_error < min_hist_error)
                 {
-
-                    if (hist_error < min_hist_error)
-                    {
-                        min_hist_error = hist_error;
-                        Eigen::Vector4f centroid;
-                        GeometricProperties::getCentroid3D<pcl::PointXYZRGB>(*pcl_3d_segment, centroid);
-
-                        owner_pos.center.x = centroid[0];
-                        owner_pos.center.y = centroid[1];
-                        found_owner = true;
-                    }
+                    min_hist_error = columns[c].histogram_error;
+                    owner_column = c;
                 }
-
-                cvReleaseImage(&ipl_roi_segment);
             }
-            if (found_owner)
-            {
 
-                mcr_perception_msgs::LaserScanSegmentList owner_list;
-                owner_list.segments.push_back(owner_pos);
-                tracker->initialize(owner_list);
+            if (owner_column >= 0)
+            {
+                tracker->clear();
+                owner_target_id = tracker->addTarget(columns[owner_column].segment);
 
                 is_tracker_initialized = true;
                 is_pointcloud_processing_enabled = false;
 
                 ROS_INFO("Owner RECOGNIZED!");
             }
-
         }
     }
 
     else
     {
-        //find occlusion
-        for (unsigned int i = 0; i < segmentList.segments.size(); ++i)
-        {
-            double angle = atan(segmentList.segments[i].center.y / segmentList.segments[i].center.x);
-            double distance = sqrt(pow(segmentList.segments[i].center.x, 2.0) + pow(segmentList.segments[i].center.y, 2.0));
+        const TrackingParticleFilter* owner = tracker->getTarget(owner_target_id);
+        if (owner == NULL)
+            return;
 
-            double yaw_threshold = 0;
-            if (tracker->getMostLikelyPosition()->dDistance > 2.0)
-                yaw_threshold = M_PI / 8;
-            else
-                yaw_threshold = M_PI / 6;
+        // find occlusion: a segment in front of the owner within the yaw threshold. The estimate is cached by the
+        // filter, so this is a single pass over the segments.
+        const StrPoint &owner_position = owner->getMostLikelyPosition();
+        double yaw_threshold = (owner_position.dDistance > 2.0) ? M_PI / 8 : M_PI / 6;
+        double max_distance = owner_position.dDistance - 0.3;
+        double min_yaw = owner_position.dYaw - yaw_threshold;
+        double max_yaw = owner_position.dYaw + yaw_threshold;
 
-            if (distance < (tracker->getMostLikelyPosition()->dDistance - 0.3)
-                    && (angle >= (tracker->getMostLikelyPosition()->dYaw - yaw_threshold) && angle <= (tracker->getMostLikelyPosition()->dYaw + yaw_threshold)))
-            {
-                //ToDo: comment in
+        // the squared distance is compared, which needs a positive threshold
+        double max_squared_distance = (max_distance > 0) ? max_distance * max_distance : -1.0;
 
-                //cout << "occl dist: " <<  distance << " target dist: " << tracker->getMostLikelyPosition()->dDistance << endl;
-                //cout << "occl yaw: " <<  angle << " target dYaw: " << tracker->getMostLikelyPosition()->dYaw << endl;
+        for (unsigned int i = 0; i < segmentList.segments.size(); ++i)
+        {
+            const geometry_msgs::Point &center = segmentList.segments[i].center;
+            double angle = atan(center.y / center.x);
+            double squared_distance = center.x * center.x + center.y * center.y;
 
+            if (squared_distance < max_squared_distance && angle >= min_yaw && angle <= max_yaw)
+            {
                 ROS_INFO("OCCLUSION!");
                 cout << "####### OCCLUSION ###########" << endl;
 
@@ -483,36 +743,66 @@ void laserScanCallback(const sensor_msgs::LaserScan::ConstPtr& inputScan)
         {
             //ToDo: comment in
             //cout << "update tracker" << endl;
+            mcr_perception_msgs::LaserScanSegmentList unassigned_segments;
+
             tracker->predict();
             tracker->predict();
-            tracker->update(segmentList);
-        }
+            tracker->update(segmentList, unassigned_segments);
 
-        StrPoint* mostLikelyPoint;
-        mostLikelyPoint = tracker->getMostLikelyPosition();
+            // the owner is kept until the tracking is reinitialized, the other people only while they are seen
+            vector<int> target_ids = tracker->getTargetIds();
+            for (unsigned int t = 0; t < target_ids.size(); ++t)
+            {
+                if (target_ids[t] != owner_target_id
+                        && tracker->getMissedUpdates(target_ids[t]) > static_cast<unsigned int>(dyn_recfg_parameters.max_missed_updates))
+                    tracker->removeTarget(target_ids[t]);
+            }
 
-        mcr_perception_msgs::PersonList trackedPersonList;
-        mcr_perception_msgs::Person trackedPerson;
+            // new people are picked up in the same region in which the owner is searched
+            for (unsigned int i = 0; i < unassigned_segments.segments.size(); ++i)
+            {
+                if (tracker->size() >= static_cast<unsigned int>(dyn_recfg_parameters.max_tracked_people))
+                    break;
 
-        trackedPerson.pose.header = inputScan->header;
-        trackedPerson.pose.header.stamp = ros::Time::now();
-        trackedPerson.pose.pose.position.x = mostLikelyPoint->dX;
-        trackedPerson.pose.pose.position.y = mostLikelyPoint->dY;
-        trackedPerson.pose.pose.position.z = 0.0;
-        trackedPerson.id = 0;
-        trackedPerson.is_tracked = true;
-        trackedPerson.is_occluded = is_person_occluded;
+                const mcr_perception_msgs::LaserScanSegment &segment = unassigned_segments.segments[i];
+                double dAngle = atan(segment.center.y / segment.center.x);
+                double dDistance = sqrt(pow(segment.center.x, 2.0) + pow(segment.center.y, 2.0));
 
-        trackedPersonList.persons.push_back(trackedPerson);
+                if (dDistance < dyn_recfg_parameters.distance_range_for_searching && dAngle > -dyn_recfg_parameters.angular_range_for_searching
+                        && dAngle < dyn_recfg_parameters.angular_range_for_searching)
+                    tracker->addTarget(segment);
+            }
+        }
+
+        // the owner comes first and always has the id 0
+        mcr_perception_msgs::PersonList trackedPersonList;
+        vector<int> target_ids = tracker->getTargetIds();
+        for (unsigned int t = 0; t < target_ids.size(); ++t)
+        {
+            StrPoint mostLikelyPoint = tracker->getTarget(target_ids[t])->getMostLikelyPosition();
+            bool is_owner = (target_ids[t] == owner_target_id);
+
+            mcr_perception_msgs::Person trackedPerson;
+
+            trackedPerson.pose.header = inputScan->header;
+            trackedPerson.pose.header.stamp = ros::Time::now();
+            trackedPerson.pose.pose.position.x = mostLikelyPoint.dX;
+            trackedPerson.pose.pose.position.y = mostLikelyPoint.dY;
+            trackedPerson.pose.pose.position.z = 0.0;
+            trackedPerson.id = is_owner ? 0 : target_ids[t] + 1;
+            trackedPerson.is_tracked = true;
+            trackedPerson.is_occluded = is_owner && is_person_occluded;
+
+            if (is_owner)
+                trackedPersonList.persons.insert(trackedPersonList.persons.begin(), trackedPerson);
+            else
+                trackedPersonList.persons.push_back(trackedPerson);
+        }
 
         pub_people_positions.publish(trackedPersonList);
 
         if (dyn_recfg_parameters.publish_visualization_markers)
             publishVisualizationMarker(trackedPersonList);
-
-        delete mostLikelyPoint;
-
-        //std::cout << "x: " << mostLikelyPoint->dX << " y: " << mostLikelyPoint->dY << endl;
     }
 
     //cout << "###############################" << endl;
@@ -550,7 +840,13 @@ int main(int argc, char **argv)
     g_nh_ptr = &nh;
 
     segmentor = new LaserScanSegmentation(0.20, 3);
-    tracker = new TrackingParticleFilter(100);
+    // one filter per tracked person, all updated in parallel
+    nh.param("number_of_threads", number_of_threads, static_cast<int>(boost::thread::hardware_concurrency()));
+    tracker = new TrackingParticleFilterBank(100, max(0, number_of_threads - 1));
+    // a fixed seed makes the tracking and the owner search of a recorded run reproducible, negative seeds from the time
+    nh.param("random_seed", random_seed, -1);
+    if (random_seed >= 0)
+        tracker->setSeed(random_seed);
     transform_listener = new tf::TransformListener();
 
     ros::ServiceServer service_start, service_stop;
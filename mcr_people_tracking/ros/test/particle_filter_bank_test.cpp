@@ -0,0 +1,83 @@
+/*
+ *  particle_filter_bank_test.cpp
+ *
+ *  Checks that the worker threads of the bank do not change the tracking result.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "mcr_people_tracking/particle_filter_bank.h"
+#include "tracking_test_utils.h"
+
+namespace
+{
+const unsigned int NUMBER_OF_PEOPLE = 5;
+
+void runBank(TrackingParticleFilterBank &bank, vector<StrPoint> &vecPositions, vector<unsigned int> &vecMissedUpdates,
+             vector<unsigned int> &vecUnassigned)
+{
+    mcr_perception_msgs::LaserScanSegmentList vecMeasurements, vecUnassignedSegments;
+
+    bank.setSeed(3);
+    bank.setParticleLimits(50, 500);
+
+    createMeasurements(0, NUMBER_OF_PEOPLE, vecMeasurements);
+    for (unsigned int p = 0; p < NUMBER_OF_PEOPLE; ++p)
+        bank.addTarget(vecMeasurements.segments[p]);
+
+    for (unsigned int i = 1; i <= 40; ++i)
+    {
+        // the first person leaves after a while
+        createMeasurements(i, NUMBER_OF_PEOPLE, vecMeasurements);
+        if (i > 20)
+            vecMeasurements.segments.erase(vecMeasurements.segments.begin());
+
+        bank.predict();
+        bank.update(vecMeasurements, vecUnassignedSegments);
+
+        vecUnassigned.push_back(vecUnassignedSegments.segments.size());
+
+        vector<int> vecIds = bank.getTargetIds();
+        for (unsigned int t = 0; t < vecIds.size(); ++t)
+        {
+            vecPositions.push_back(bank.getTarget(vecIds[t])->getMostLikelyPosition());
+            vecMissedUpdates.push_back(bank.getMissedUpdates(vecIds[t]));
+        }
+    }
+}
+}
+
+TEST(particle_filter_bank_test, threads_give_identical_estimates)
+{
+    vector<StrPoint> vecSerialPositions, vecThreadedPositions;
+    vector<unsigned int> vecSerialMissed, vecThreadedMissed;
+    vector<unsigned int> vecSerialUnassigned, vecThreadedUnassigned;
+
+    {
+        TrackingParticleFilterBank bank(200, 0);
+        runBank(bank, vecSerialPositions, vecSerialMissed, vecSerialUnassigned);
+    }
+    {
+        TrackingParticleFilterBank bank(200, 3);
+        runBank(bank, vecThreadedPositions, vecThreadedMissed, vecThreadedUnassigned);
+    }
+
+    EXPECT_EQ(vecSerialUnassigned, vecThreadedUnassigned);
+    EXPECT_EQ(vecSerialMissed, vecThreadedMissed);
+    ASSERT_EQ(vecSerialPositions.size(), vecThreadedPositions.size());
+
+    // bit identical, the filters of the targets do not share any state
+    for (unsigned int i = 0; i < vecSerialPositions.size(); ++i)
+    {
+        EXPECT_EQ(vecSerialPositions[i].dX, vecThreadedPositions[i].dX) << "estimate " << i;
+        EXPECT_EQ(vecSerialPositions[i].dY, vecThreadedPositions[i].dY) << "estimate " << i;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,218 @@
+/*
+ *  particle_filter_test.cpp
+ *
+ *  Checks the TrackingParticleFilter on simulated measurements.
+ */
+
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <vector>
+
+#include "mcr_people_tracking/particle_filter.h"
+#include "tracking_test_utils.h"
+
+TEST(particle_filter_test, same_seed_gives_identical_estimates)
+{
+    TrackingParticleFilter filterA(200), filterB(200), filterC(200);
+    mcr_perception_msgs::LaserScanSegmentList vecMeasurements;
+
+    // the adaptive number of particles has to be reproducible as well
+    filterA.setParticleLimits(50, 500);
+    filterB.setParticleLimits(50, 500);
+    filterC.setParticleLimits(50, 500);
+    filterA.setSeed(42);
+    filterB.setSeed(42);
+    filterC.setSeed(43);
+
+    createMeasurements(0, 1, vecMeasurements);
+    vecMeasurements.segments.resize(1);
+    ASSERT_EQ(0, filterA.initialize(vecMeasurements));
+    ASSERT_EQ(0, filterB.initialize(vecMeasurements));
+    ASSERT_EQ(0, filterC.initialize(vecMeasurements));
+
+    bool bSeedsDiffer = false;
+    for (unsigned int i = 1; i <= 50; ++i)
+    {
+        createMeasurements(i, 1, vecMeasurements);
+
+        filterA.predict();
+        filterB.predict();
+        filterC.predict();
+        filterA.update(vecMeasurements);
+        filterB.update(vecMeasurements);
+        filterC.update(vecMeasurements);
+
+        // bit identical, not only close
+        ASSERT_EQ(filterA.getParticles().size(), filterB.getParticles().size()) << "step " << i;
+        EXPECT_EQ(filterA.getMostLikelyPosition().dX, filterB.getMostLikelyPosition().dX) << "step " << i;
+        EXPECT_EQ(filterA.getMostLikelyPosition().dY, filterB.getMostLikelyPosition().dY) << "step " << i;
+        EXPECT_EQ(filterA.getMostLikelyParticle().dX, filterB.getMostLikelyParticle().dX) << "step " << i;
+        EXPECT_EQ(filterA.getMostLikelyParticle().dY, filterB.getMostLikelyParticle().dY) << "step " << i;
+
+        bSeedsDiffer = bSeedsDiffer || filterA.getMostLikelyPosition().dX != filterC.getMostLikelyPosition().dX;
+    }
+
+    EXPECT_TRUE(bSeedsDiffer);
+}
+
+TEST(particle_filter_test, resampling_keeps_weighted_mean)
+{
+    const unsigned int unNumberOfParticles = 2000;
+    mcr_perception_msgs::LaserScanSegmentList vecMeasurements;
+
+    for (uint64_t unSeed = 1; unSeed <= 10; ++unSeed)
+    {
+        // both filters draw the same particles, only the second one resamples after the update
+        TrackingParticleFilter filterWeighted(unNumberOfParticles), filterResampled(unNumberOfParticles);
+        filterWeighted.setSeed(unSeed);
+        filterResampled.setSeed(unSeed);
+        filterWeighted.setResamplingThreshold(0.0);
+        filterResampled.setResamplingThreshold(1.0);
+
+        vecMeasurements.segments.assign(1, createSegment(2.0, -1.0));
+        filterWeighted.initialize(vecMeasurements);
+        filterResampled.initialize(vecMeasurements);
+
+        // the particles spread out without measurements
+        for (unsigned int i = 0; i < 10; ++i)
+        {
+            filterWeighted.predict();
+            filterResampled.predict();
+        }
+
+        // the measurement is off the center of the particles, so the weights are far from uniform
+        vecMeasurements.segments.assign(1, createSegment(2.3, -1.2));
+        filterWeighted.update(vecMeasurements);
+        filterResampled.update(vecMeasurements);
+
+        ASSERT_EQ(unNumberOfParticles, filterWeighted.getParticles().size());
+        ASSERT_EQ(unNumberOfParticles, filterResampled.getParticles().size());
+        EXPECT_LT(filterWeighted.getEffectiveSampleSize(), 0.5 * unNumberOfParticles);
+        EXPECT_NEAR(unNumberOfParticles, filterResampled.getEffectiveSampleSize(), 1e-6);
+
+        // the unweighted mean of the particles is far from the weighted one
+        const StrParticleSet &strParticles = filterWeighted.getParticles();
+        double dMeanX = 0;
+        for (unsigned int i = 0; i < strParticles.size(); ++i)
+            dMeanX += strParticles.vecX[i] / strParticles.size();
+        EXPECT_GT(fabs(dMeanX - filterWeighted.getMostLikelyPosition().dX), 0.1) << "seed " << unSeed;
+
+        EXPECT_NEAR(filterWeighted.getMostLikelyPosition().dX, filterResampled.getMostLikelyPosition().dX, 5e-3)
+                << "seed " << unSeed;
+        EXPECT_NEAR(filterWeighted.getMostLikelyPosition().dY, filterResampled.getMostLikelyPosition().dY, 5e-3)
+                << "seed " << unSeed;
+    }
+}
+
+TEST(particle_filter_test, clutter_outside_gate_keeps_estimates)
+{
+    TrackingParticleFilter filterPlain(200), filterCluttered(200);
+    mcr_perception_msgs::LaserScanSegmentList vecMeasurements;
+
+    filterPlain.setParticleLimits(50, 500);
+    filterCluttered.setParticleLimits(50, 500);
+    filterPlain.setSeed(5);
+    filterCluttered.setSeed(5);
+
+    createMeasurements(0, 1, vecMeasurements);
+    vecMeasurements.segments.resize(1);
+    filterPlain.initialize(vecMeasurements);
+    filterCluttered.initialize(vecMeasurements);
+
+    for (unsigned int i = 1; i <= 30; ++i)
+    {
+        // the first filter scores all segments, the clutter makes the second one use the grid
+        createMeasurements(i, 1, vecMeasurements);
+        filterPlain.predict();
+        filterPlain.update(vecMeasurements);
+
+        vecMeasurements.segments.push_back(createSegment(10.0, 10.0));
+        vecMeasurements.segments.push_back(createSegment(-10.0, 10.0));
+        vecMeasurements.segments.push_back(createSegment(10.0, -10.0));
+        vecMeasurements.segments.push_back(createSegment(-10.0, -10.0));
+        filterCluttered.predict();
+        filterCluttered.update(vecMeasurements);
+
+        ASSERT_EQ(filterPlain.getParticles().size(), filterCluttered.getParticles().size()) << "step " << i;
+        EXPECT_EQ(filterPlain.getMostLikelyPosition().dX, filterCluttered.getMostLikelyPosition().dX) << "step " << i;
+        EXPECT_EQ(filterPlain.getMostLikelyPosition().dY, filterCluttered.getMostLikelyPosition().dY) << "step " << i;
+    }
+}
+
+TEST(particle_filter_test, lost_target_scores_all_segments)
+{
+    const unsigned int unNumberOfParticles = 500;
+    TrackingParticleFilter filter(unNumberOfParticles);
+    mcr_perception_msgs::LaserScanSegmentList vecMeasurements;
+
+    // keep the weights of the update instead of resampling them
+    filter.setSeed(9);
+    filter.setResamplingThreshold(0.0);
+
+    vecMeasurements.segments.assign(1, createSegment(0.0, 0.0));
+    filter.initialize(vecMeasurements);
+    for (unsigned int i = 0; i < 5; ++i)
+        filter.predict();
+
+    // enough segments for the grid, but none of them in the cells around the particles
+    vecMeasurements.segments.clear();
+    vecMeasurements.segments.push_back(createSegment(2.5, 0.0));
+    vecMeasurements.segments.push_back(createSegment(3.0, 3.0));
+    vecMeasurements.segments.push_back(createSegment(-3.0, 3.0));
+    vecMeasurements.segments.push_back(createSegment(-3.0, -3.0));
+    vecMeasurements.segments.push_back(createSegment(3.0, -3.0));
+    filter.update(vecMeasurements);
+
+    const StrParticleSet &strParticles = filter.getParticles();
+    ASSERT_EQ(unNumberOfParticles, strParticles.size());
+
+    double dMeanX = 0;
+    for (unsigned int i = 0; i < strParticles.size(); ++i)
+    {
+        EXPECT_EQ(0, strParticles.vecCorrespondToObj[i]) << "particle " << i;
+        dMeanX += strParticles.vecX[i] / strParticles.size();
+    }
+
+    // uniform weights would keep the estimate at the mean of the particles
+    EXPECT_LT(filter.getEffectiveSampleSize(), 0.5 * unNumberOfParticles);
+    EXPECT_GT(filter.getMostLikelyPosition().dX, dMeanX + 0.1);
+}
+
+TEST(particle_filter_test, tracked_target_needs_fewer_particles)
+{
+    mcr_perception_msgs::LaserScanSegmentList vecMeasurements;
+
+    for (uint64_t unSeed = 1; unSeed <= 10; ++unSeed)
+    {
+        // the number of particles of the waist tracker before it adapted
+        TrackingParticleFilter filter(100);
+        filter.setSeed(unSeed);
+        filter.setParticleLimits(50, 500);
+
+        createMeasurements(0, 1, vecMeasurements);
+        vecMeasurements.segments.resize(1);
+        filter.initialize(vecMeasurements);
+
+        // the waist tracker predicts twice per scan
+        double dMeanSize = 0;
+        for (unsigned int i = 1; i <= 100; ++i)
+        {
+            createMeasurements(i, 1, vecMeasurements);
+            filter.predict();
+            filter.predict();
+            filter.update(vecMeasurements);
+
+            if (i > 50)
+                dMeanSize += filter.getParticles().size() / 50.0;
+        }
+
+        EXPECT_LT(dMeanSize, 100) << "seed " << unSeed;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
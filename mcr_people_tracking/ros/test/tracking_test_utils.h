@@ -0,0 +1,35 @@
+/*
+ *  tracking_test_utils.h
+ *
+ *  Measurements shared by the tests of the particle filters.
+ */
+
+#ifndef TRACKINGTESTUTILS_H_
+#define TRACKINGTESTUTILS_H_
+
+#include <mcr_perception_msgs/LaserScanSegmentList.h>
+#include <mcr_perception_msgs/LaserScanSegment.h>
+
+inline mcr_perception_msgs::LaserScanSegment createSegment(double dX, double dY)
+{
+    mcr_perception_msgs::LaserScanSegment segment;
+    segment.center.x = dX;
+    segment.center.y = dY;
+
+    return segment;
+}
+
+/*
+ * people walking side by side away from the robot and a static object next to their path,
+ * the segments of the people come first
+ */
+inline void createMeasurements(unsigned int unStep, unsigned int unNumberOfPeople,
+                               mcr_perception_msgs::LaserScanSegmentList &vecMeasurements)
+{
+    vecMeasurements.segments.clear();
+    for (unsigned int p = 0; p < unNumberOfPeople; ++p)
+        vecMeasurements.segments.push_back(createSegment(1.0 + 0.02 * unStep, 0.5 - 1.5 * p - 0.01 * unStep));
+    vecMeasurements.segments.push_back(createSegment(1.5, 1.2));
+}
+
+#endif /* TRACKINGTESTUTILS_H_ */
@@ -0,0 +1,79 @@
+/*!
+ * @copyright 2018 Bonn-Rhein-Sieg University
+ */
+#ifndef MCR_SCAN_GEOMETRY_SCAN_GEOMETRY_H
+#define MCR_SCAN_GEOMETRY_SCAN_GEOMETRY_H
+
+#include <stdint.h>
+#include <vector>
+
+#include <sensor_msgs/LaserScan.h>
+
+/** Cartesian representation of a laser scan in the frame of the scanner, stored as
+  * structure of arrays. Entry i belongs to beam i of the source scan. Beams whose range
+  * is not strictly between range_min and range_max keep their (possibly non-finite)
+  * coordinates but are marked with valid[i] == 0. */
+struct CartesianScan
+{
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> range;
+    std::vector<uint8_t> valid;
+
+    size_t size() const
+    {
+        return x.size();
+    }
+};
+
+/** Caches the cos/sin tables of a laser scanner. The geometry of a scan (angle_min,
+  * angle_increment and number of beams) is fixed for a device, so the tables are only
+  * rebuilt when a scan with a different geometry arrives. */
+class ScanGeometry
+{
+public:
+    /* angle_offset in radians, added to every beam angle (e.g. to correct the mounting) */
+    explicit ScanGeometry(double angle_offset = 0.0);
+
+    /** Rebuilds the tables if the geometry of the scan differs from the cached one.
+      * @return true if the tables were rebuilt */
+    bool update(const sensor_msgs::LaserScan &scan);
+
+    /** Converts all beams of the scan into Cartesian coordinates in a single pass,
+      * updating the tables first if required. */
+    void toCartesian(const sensor_msgs::LaserScan &scan, CartesianScan &cartesian);
+
+    /** Returns the [begin, end) range of beams whose angle lies within [min_angle, max_angle]. */
+    void getIndexRange(double min_angle, double max_angle, size_t &begin, size_t &end) const;
+
+    size_t size() const
+    {
+        return angles_.size();
+    }
+
+    float getAngle(size_t index) const
+    {
+        return angles_[index];
+    }
+
+    float getCos(size_t index) const
+    {
+        return cos_table_[index];
+    }
+
+    float getSin(size_t index) const
+    {
+        return sin_table_[index];
+    }
+
+private:
+    double angle_offset_;
+    float angle_min_;
+    float angle_increment_;
+
+    std::vector<float> angles_;
+    std::vector<float> cos_table_;
+    std::vector<float> sin_table_;
+};
+
+#endif  // MCR_SCAN_GEOMETRY_SCAN_GEOMETRY_H
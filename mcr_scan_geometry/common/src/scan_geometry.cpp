@@ -0,0 +1,80 @@
+/*!
+ * @copyright 2018 Bonn-Rhein-Sieg University
+ */
+#include <algorithm>
+#include <cmath>
+#include "mcr_scan_geometry/scan_geometry.h"
+
+ScanGeometry::ScanGeometry(double angle_offset)
+    : angle_offset_(angle_offset), angle_min_(0.0), angle_increment_(0.0)
+{
+}
+
+bool ScanGeometry::update(const sensor_msgs::LaserScan &scan)
+{
+    if (scan.ranges.size() == angles_.size() && scan.angle_min == angle_min_ &&
+        scan.angle_increment == angle_increment_)
+        return false;
+
+    angle_min_ = scan.angle_min;
+    angle_increment_ = scan.angle_increment;
+
+    size_t size = scan.ranges.size();
+    angles_.resize(size);
+    cos_table_.resize(size);
+    sin_table_.resize(size);
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        double angle = angle_offset_ + angle_min_ + i * static_cast<double>(angle_increment_);
+        angles_[i] = static_cast<float>(angle);
+        cos_table_[i] = static_cast<float>(cos(angle));
+        sin_table_[i] = static_cast<float>(sin(angle));
+    }
+
+    return true;
+}
+
+void ScanGeometry::toCartesian(const sensor_msgs::LaserScan &scan, CartesianScan &cartesian)
+{
+    update(scan);
+
+    size_t size = scan.ranges.size();
+    cartesian.x.resize(size);
+    cartesian.y.resize(size);
+    cartesian.range.resize(size);
+    cartesian.valid.resize(size);
+
+    std::copy(scan.ranges.begin(), scan.ranges.end(), cartesian.range.begin());
+
+    // one plain loop per output array, so that each of them is vectorized by the compiler
+
+    const float *ranges = cartesian.range.data();
+    const float *cos_table = cos_table_.data();
+    const float *sin_table = sin_table_.data();
+    float *x = cartesian.x.data();
+    float *y = cartesian.y.data();
+    uint8_t *valid = cartesian.valid.data();
+    const float range_min = scan.range_min;
+    const float range_max = scan.range_max;
+
+    for (size_t i = 0; i < size; ++i)
+        x[i] = ranges[i] * cos_table[i];
+
+    for (size_t i = 0; i < size; ++i)
+        y[i] = ranges[i] * sin_table[i];
+
+    for (size_t i = 0; i < size; ++i)
+        valid[i] = static_cast<uint8_t>((ranges[i] > range_min) & (ranges[i] < range_max));
+}
+
+void ScanGeometry::getIndexRange(double min_angle, double max_angle, size_t &begin, size_t &end) const
+{
+    begin = 0;
+    while (begin < angles_.size() && (angles_[begin] < min_angle || angles_[begin] > max_angle))
+        ++begin;
+
+    end = begin;
+    while (end < angles_.size() && angles_[end] >= min_angle && angles_[end] <= max_angle)
+        ++end;
+}
@@ -4,14 +4,25 @@
 #ifndef MCR_SCENE_SEGMENTATION_LASERSCAN_SEGMENTATION_H
 #define MCR_SCENE_SEGMENTATION_LASERSCAN_SEGMENTATION_H
 
+#include <vector>
 #include <sensor_msgs/LaserScan.h>
 #include <mcr_perception_msgs/LaserScanSegmentList.h>
 #include <mcr_perception_msgs/LaserScanSegment.h>
 #include <geometry_msgs/Pose.h>
+#include <mcr_scan_geometry/scan_geometry.h>
 
 class LaserScanSegmentation
 {
 public:
+    /** A segment as the [start, end) beam index range of the last segmented scan */
+    struct SegmentRange
+    {
+        unsigned int start;
+        unsigned int end;
+        double center_x;
+        double center_y;
+    };
+
     /* dThresholdDistanceBetweenAdajecentPoints in meters */
     LaserScanSegmentation(double dThresholdDistanceBetweenAdajecentPoints, unsigned int unMinimumPointsPerSegment);
     ~LaserScanSegmentation();
@@ -19,18 +30,29 @@ public:
     mcr_perception_msgs::LaserScanSegmentList
     getSegments(const sensor_msgs::LaserScan::ConstPtr &inputScan, bool store_data_points = false);
 
+    /** Segments the scan without building any messages. The returned ranges index into
+      * getCartesianScan() and stay valid until the next call. */
+    const std::vector<SegmentRange>&
+    segment(const sensor_msgs::LaserScan &inputScan);
+
+    /** Builds the message for the segments found by the last call of segment() */
+    mcr_perception_msgs::LaserScanSegmentList
+    toSegmentList(const std_msgs::Header &header, bool store_data_points = false) const;
+
+    const CartesianScan&
+    getCartesianScan() const
+    {
+        return _cartesianScan;
+    }
+
 private:
     /* distance threshold between two adjacent laser scan points to determine where a new segment starts in meters */
     double _dThresholdDistanceBetweenAdajecentPoints;
     unsigned int _unMinimumPointsPerSegment;
 
-
-    double
-    getEuclideanDistance(double dDistanceA, double dAngleA, double dDistanceB, double dAngleB);
-
-    geometry_msgs::Point
-    getCenterOfGravity(unsigned int indexStart, unsigned int indexEnd,
-                       const sensor_msgs::LaserScan::ConstPtr &inputScan);
+    ScanGeometry _scanGeometry;
+    CartesianScan _cartesianScan;
+    std::vector<SegmentRange> _segmentRanges;
 };
 
 #endif  // MCR_SCENE_SEGMENTATION_LASERSCAN_SEGMENTATION_H
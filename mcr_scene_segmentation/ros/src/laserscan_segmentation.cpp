@@ -1,6 +1,7 @@
 /*!
  * @copyright 2018 Bonn-Rhein-Sieg University
  */
+#include <algorithm>
 #include <vector>
 #include "mcr_scene_segmentation/laserscan_segmentation.h"
 
@@ -16,121 +17,109 @@ LaserScanSegmentation::~LaserScanSegmentation() = default;
 mcr_perception_msgs::LaserScanSegmentList
 LaserScanSegmentation::getSegments(const sensor_msgs::LaserScan::ConstPtr &inputScan, bool store_data_points)
 {
-    mcr_perception_msgs::LaserScanSegmentList segments;
-    std::vector<geometry_msgs::Point> data_points;
+    segment(*inputScan);
 
-    double dNumberofPointsBetweenStartAndEnd = 0;
-    unsigned int unSegmentStartPoint = 0;
-    unsigned int unSegmentEndPoint = 0;
+    return toSegmentList(inputScan->header, store_data_points);
+}
+
+const std::vector<LaserScanSegmentation::SegmentRange>&
+LaserScanSegmentation::segment(const sensor_msgs::LaserScan &inputScan)
+{
+    _segmentRanges.clear();
 
     auto scan_size = static_cast<uint32_t>(
-            ceil((inputScan->angle_max - inputScan->angle_min) / inputScan->angle_increment));
+            ceil((inputScan.angle_max - inputScan.angle_min) / inputScan.angle_increment));
+    scan_size = std::min(scan_size, static_cast<uint32_t>(inputScan.ranges.size()));
 
-    if (scan_size == 0)
-        return segments;
+    if (scan_size < 2)
+        return _segmentRanges;
 
-    // run over laser scan data
+    _scanGeometry.toCartesian(inputScan, _cartesianScan);
+
+    const float *x = _cartesianScan.x.data();
+    const float *y = _cartesianScan.y.data();
+    const double dThresholdSquared = _dThresholdDistanceBetweenAdajecentPoints *
+                                     _dThresholdDistanceBetweenAdajecentPoints;
+    // segments whose center is further away than 5m are ignored
+    const double dMaxDistanceToSegmentSquared = 5.0 * 5.0;
+
+    unsigned int unSegmentStartPoint = 0;
+    double dSumX = 0.0;
+    double dSumY = 0.0;
+
+    // run over laser scan data, accumulating the center of the current segment on the way
     for (unsigned int i = 0; i < (scan_size - 1); ++i)
     {
-        ++dNumberofPointsBetweenStartAndEnd;
+        dSumX += x[i];
+        dSumY += y[i];
 
-        // first point in laser scan is start point of the first segment
-        if (i == 0)
-            unSegmentStartPoint = i;
+        double dDeltaX = x[i + 1] - x[i];
+        double dDeltaY = y[i + 1] - y[i];
+        bool bIsLastPoint = (i == (scan_size - 2));
 
-        double dAngleCur = inputScan->angle_min + (i * inputScan->angle_increment);
-        double dDistanceCur = inputScan->ranges[i];
-        double dAngleNext = inputScan->angle_min + ((i + 1) * inputScan->angle_increment);
-        double dDistanceNext = inputScan->ranges[i + 1];
+        if (!((dDeltaX * dDeltaX + dDeltaY * dDeltaY) > dThresholdSquared) && !bIsLastPoint)
+            continue;
 
-        if (store_data_points)
+        unsigned int unNumberOfPoints = i + 1 - unSegmentStartPoint;
+        unsigned int unSegmentEndPoint = i + 1;
+
+        // the last point of the scan always belongs to the last segment
+        if (bIsLastPoint)
         {
-            geometry_msgs::Point cur_point;
-            cur_point.x = dDistanceCur * cos(dAngleCur);
-            cur_point.y = dDistanceCur * sin(dAngleCur);
-            data_points.push_back(cur_point);
+            dSumX += x[i + 1];
+            dSumY += y[i + 1];
+            ++unSegmentEndPoint;
         }
 
-        if ((getEuclideanDistance(dDistanceCur, dAngleCur, dDistanceNext, dAngleNext)
-            > this->_dThresholdDistanceBetweenAdajecentPoints)
-            || (i == (scan_size - 2)))
+        if (unNumberOfPoints >= this->_unMinimumPointsPerSegment)
         {
-            if (i < (scan_size - 2))
-                unSegmentEndPoint = i;
-            else
-                unSegmentEndPoint = i + 1;
-
-            // if number of points between start and end point is lesser then 3 , it is not a segment
-            if (dNumberofPointsBetweenStartAndEnd >= this->_unMinimumPointsPerSegment)
-            {
-                geometry_msgs::Point centerPoint;
-                centerPoint = getCenterOfGravity(unSegmentStartPoint, unSegmentEndPoint, inputScan);
-                double dDistanceToSegment = sqrt(pow(centerPoint.x, 2.0) + pow(centerPoint.y, 2.0));
-
-                if (dDistanceToSegment < 5.0)
-                {
-                    mcr_perception_msgs::LaserScanSegment seg;
-
-                    seg.header = inputScan->header;
-                    seg.header.stamp = ros::Time::now();
-                    seg.center.x = centerPoint.x;
-                    seg.center.y = centerPoint.y;
-
-                    if (store_data_points)
-                        seg.data_points = data_points;
-
-                    segments.segments.push_back(seg);
-                }
-            }
-
-            if (i < (scan_size - 2))
-            {
-                unSegmentStartPoint = i + 1;
-                dNumberofPointsBetweenStartAndEnd = 0;
-
-                if (store_data_points)
-                    data_points.clear();
-            }
+            SegmentRange seg;
+            seg.start = unSegmentStartPoint;
+            seg.end = unSegmentEndPoint;
+            seg.center_x = dSumX / (unSegmentEndPoint - unSegmentStartPoint);
+            seg.center_y = dSumY / (unSegmentEndPoint - unSegmentStartPoint);
+
+            if ((seg.center_x * seg.center_x + seg.center_y * seg.center_y) < dMaxDistanceToSegmentSquared)
+                _segmentRanges.push_back(seg);
         }
-    }
-
-    segments.header = inputScan->header;
-    segments.header.stamp = ros::Time::now();
-    segments.num_segments = static_cast<unsigned int>(segments.segments.size());
 
-    return segments;
-}
+        unSegmentStartPoint = i + 1;
+        dSumX = 0.0;
+        dSumY = 0.0;
+    }
 
-double
-LaserScanSegmentation::getEuclideanDistance(double dDistanceA, double dAngleA, double dDistanceB, double dAngleB)
-{
-    return sqrt((dDistanceA * dDistanceA) + (dDistanceB * dDistanceB) -
-                (2 * dDistanceA * dDistanceB) * cos(fabs(dAngleA - dAngleB)));
+    return _segmentRanges;
 }
 
-geometry_msgs::Point
-LaserScanSegmentation::getCenterOfGravity(unsigned int indexStart, unsigned int indexEnd,
-                                          const sensor_msgs::LaserScan::ConstPtr &inputScan)
+mcr_perception_msgs::LaserScanSegmentList
+LaserScanSegmentation::toSegmentList(const std_msgs::Header &header, bool store_data_points) const
 {
-    geometry_msgs::Point centerPoint;
+    mcr_perception_msgs::LaserScanSegmentList segments;
 
-    centerPoint.x = 0;
-    centerPoint.y = 0;
-    centerPoint.z = 0;
+    segments.header = header;
+    segments.header.stamp = ros::Time::now();
+    segments.segments.resize(_segmentRanges.size());
+    segments.num_segments = static_cast<unsigned int>(_segmentRanges.size());
 
-    unsigned int i = 0, j = 0;
-    for (i = indexStart, j = 0; i <= indexEnd; ++i, ++j)
+    for (size_t i = 0; i < _segmentRanges.size(); ++i)
     {
-        double dAngle = inputScan->angle_min + (i * inputScan->angle_increment);
-        double dX = inputScan->ranges[i] * cos(dAngle);
-        double dY = inputScan->ranges[i] * sin(dAngle);
+        const SegmentRange &range = _segmentRanges[i];
+        mcr_perception_msgs::LaserScanSegment &seg = segments.segments[i];
 
-        centerPoint.x += dX;
-        centerPoint.y += dY;
-    }
+        seg.header = segments.header;
+        seg.center.x = range.center_x;
+        seg.center.y = range.center_y;
 
-    centerPoint.x /= j;
-    centerPoint.y /= j;
+        if (store_data_points)
+        {
+            seg.data_points.resize(range.end - range.start);
+            for (unsigned int j = range.start; j < range.end; ++j)
+            {
+                seg.data_points[j - range.start].x = _cartesianScan.x[j];
+                seg.data_points[j - range.start].y = _cartesianScan.y[j];
+            }
+        }
+    }
 
-    return centerPoint;
+    return segments;
 }